@@ -0,0 +1,35 @@
+#ifndef _ASSETLOADER_H
+#define _ASSETLOADER_H
+
+#include <functional>
+
+// Carregamento paralelo de recursos (imagens e modelos). Cada tarefa é
+// dividida em duas partes: "work", executada em uma das threads de
+// carregamento, que lê e decodifica os arquivos sem nenhuma chamada OpenGL; e
+// "finish", executada na thread da OpenGL por AssetLoader_Update(), que envia
+// os dados já prontos para a GPU. As partes "finish" são executadas na mesma
+// ordem em que as tarefas foram submetidas, de forma que o resultado do
+// carregamento não depende da ordem em que as threads terminam.
+// Veja LoadTextureImage() e LoadModelAndAddToVirtualScene() em "main.cpp".
+
+// Cria as threads de carregamento. Com num_threads == 0, é criada uma thread
+// por núcleo do processador.
+void AssetLoader_Start(unsigned int num_threads = 0);
+
+// Agenda uma tarefa de carregamento
+void AssetLoader_Submit(const std::function<void()>& work, const std::function<void()>& finish);
+
+// Executa as partes "finish" das tarefas já concluídas pelas threads.
+// Retorna true quando todas as tarefas submetidas foram finalizadas.
+bool AssetLoader_Update();
+
+// Número de tarefas finalizadas e submetidas, para a tela de carregamento
+void AssetLoader_GetProgress(int* finished, int* total);
+
+// Número de threads de carregamento
+unsigned int AssetLoader_NumThreads();
+
+// Aguarda o término das threads de carregamento
+void AssetLoader_Stop();
+
+#endif // _ASSETLOADER_H
@@ -0,0 +1,57 @@
+#ifndef _LIGHTCLUSTERS_H
+#define _LIGHTCLUSTERS_H
+
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+// Iluminação "clustered forward": o frustum da câmera é dividido em
+// CLUSTER_TILES_X x CLUSTER_TILES_Y regiões da tela e CLUSTER_SLICES fatias de
+// profundidade, e cada um destes clusters recebe a lista das fontes de luz
+// pontuais que o alcançam. Cada fragmento percorre somente a lista do seu
+// cluster, de forma que o custo depende das luzes próximas, e não do total
+// de luzes da cena. As listas são construídas na CPU a cada quadro e enviadas
+// para a GPU como buffer textures (veja UpdateLightClusters() em "main.cpp" e
+// ClusteredLighting() em "shader_fragment.glsl").
+//
+// As fatias de profundidade são exponenciais: a fatia de um ponto a uma
+// distância d da câmera (ao longo do eixo de visão) é
+//   floor(log(d/near) / log(far/near) * CLUSTER_SLICES)
+// e os clusters próximos da câmera são menores, como os objetos na tela.
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 12
+#define CLUSTER_SLICES  24
+#define NUM_CLUSTERS    (CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES)
+
+// Número máximo de índices de luzes em todas as listas de um quadro (o
+// tamanho mínimo de uma buffer texture garantido pela OpenGL). As luzes
+// que não cabem são ignoradas nos clusters restantes.
+#define MAX_CLUSTER_LIGHT_INDICES 65536
+
+// Fonte de luz pontual, cuja intensidade cai até zero na distância "radius"
+struct PointLight
+{
+    glm::vec3 position; // Coordenadas globais
+    float     radius;
+    glm::vec3 color;    // Espectro (intensidade) da luz
+};
+
+// Listas de luzes de todos os clusters. O cluster (x, y, z) tem o índice
+// (z*CLUSTER_TILES_Y + y)*CLUSTER_TILES_X + x, e a sua lista é formada por
+// indices[offset[i]] ... indices[offset[i] + count[i] - 1].
+struct LightClusters
+{
+    std::vector<unsigned int> offset_count; // (offset, count) de cada cluster
+    std::vector<unsigned int> indices;      // Índices em "lights"
+
+    std::vector<unsigned int> pairs; // (cluster, luz), utilizado durante a construção
+};
+
+// Constrói as listas de luzes dos clusters para a câmera dada por "view" e
+// "projection", cujos planos near e far estão às distâncias "near" e "far"
+// (positivas) da câmera. O volume de cada luz é aproximado pela sua caixa
+// envolvente, então uma luz pode aparecer em alguns clusters que não alcança.
+void LightClusters_Build(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection, float near, float far, LightClusters& clusters);
+
+#endif // _LIGHTCLUSTERS_H
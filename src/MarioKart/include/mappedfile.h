@@ -0,0 +1,22 @@
+#ifndef _MAPPEDFILE_H
+#define _MAPPEDFILE_H
+
+#include <cstddef>
+
+// Arquivo somente de leitura mapeado em memória, utilizado pelos arquivos
+// pré-processados pelo "cooker" (veja "meshfile.h" e "texturefile.h"). Em
+// sistemas sem mmap() o arquivo é lido inteiro de uma só vez.
+struct MappedFile
+{
+    void*  data; // Conteúdo do arquivo
+    size_t size;
+};
+
+// Mapeia um arquivo em memória. Retorna false se o arquivo não existe, está
+// vazio ou é mais antigo que o arquivo "source_filename" do qual foi gerado
+// (se não for NULL).
+bool MappedFile_Open(const char* filename, const char* source_filename, MappedFile& file);
+
+void MappedFile_Close(MappedFile& file);
+
+#endif // _MAPPEDFILE_H
@@ -0,0 +1,59 @@
+#ifndef _MESHFILE_H
+#define _MESHFILE_H
+
+#include <string>
+
+#include "mappedfile.h"
+#include "meshprocessing.h"
+
+// Formato binário das malhas pré-processadas (".mesh"), gerado pelo programa
+// "cooker" (veja "cooker.cpp") a partir dos modelos ".obj". O arquivo contém
+// exatamente os dados de MeshData, já no formato da GPU, e é mapeado em
+// memória pelo jogo, de forma que os vértices e índices são copiados
+// diretamente para os buffers da cena, sem nenhum processamento.
+//
+// Layout (little-endian, todos os campos alinhados em 4 bytes):
+//   MeshFileHeader
+//   MeshShape    shapes[num_shapes]
+//   SceneVertex  vertices[num_vertices]
+//   unsigned int indices[num_indices]
+#define MESH_FILE_MAGIC   0x48534D4B // "KMSH"
+#define MESH_FILE_VERSION 1
+
+struct MeshFileHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int num_shapes;
+    unsigned int num_vertices;
+    unsigned int num_indices;
+    unsigned int reserved;
+};
+
+// Arquivo ".mesh" aberto por MeshFile_Open(). Os ponteiros apontam para dentro
+// do arquivo mapeado e são válidos até MeshFile_Close().
+struct MeshFile
+{
+    const MeshFileHeader* header;
+    const MeshShape*      shapes;
+    const SceneVertex*    vertices;
+    const unsigned int*   indices;
+
+    MappedFile mapping;
+};
+
+// Nome do arquivo ".mesh" correspondente a um modelo ".obj"
+std::string MeshFile_CookedFilename(const char* obj_filename);
+
+// Grava uma malha processada em um arquivo ".mesh". Retorna false em caso de erro.
+bool MeshFile_Write(const char* filename, const MeshData& mesh);
+
+// Abre um arquivo ".mesh". Retorna false se o arquivo não existe, é inválido
+// (inclusive se algum objeto ou índice aponta para fora dos dados do
+// arquivo), foi gerado por outra versão do formato ou é mais antigo que o
+// modelo "source_filename" do qual foi gerado (se não for NULL).
+bool MeshFile_Open(const char* filename, const char* source_filename, MeshFile& file);
+
+void MeshFile_Close(MeshFile& file);
+
+#endif // _MESHFILE_H
@@ -0,0 +1,105 @@
+#ifndef _MESHPROCESSING_H
+#define _MESHPROCESSING_H
+
+#include <string>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+
+// Funções de pré-processamento de malhas de triângulos. São executadas
+// offline pelo "cooker" (veja "cooker.cpp" e "meshfile.h"), ou durante o
+// carregamento dos modelos quando não existe um arquivo ".mesh" atualizado
+// (veja LoadModelAndAddToVirtualScene() em "main.cpp").
+
+// Número máximo de níveis de detalhe (LODs) de um objeto. O nível 0 é a malha
+// original; cada nível seguinte tem aproximadamente metade dos triângulos do
+// anterior. Somente objetos com pelo menos LOD_MIN_TRIANGLES triângulos são
+// simplificados. Veja MeshProcessing_BuildMesh().
+#define MAX_LEVELS_OF_DETAIL 4
+#define LOD_MIN_TRIANGLES    1024
+
+// Vértice de uma malha, com todos os atributos utilizados pelos shaders. Dois
+// vértices são considerados iguais somente se todos os atributos são iguais.
+struct MeshVertex
+{
+    float position[3];
+    float normal[3];
+    float texcoord[2];
+};
+
+// Une os vértices repetidos de uma malha não indexada ("unindexed", onde cada
+// três vértices formam um triângulo), gerando uma lista de vértices únicos e
+// os índices que a referenciam. A ordem dos triângulos é mantida.
+void MeshProcessing_WeldVertices(const std::vector<MeshVertex>& unindexed, std::vector<MeshVertex>& vertices, std::vector<unsigned int>& indices);
+
+// Reordena os triângulos de um intervalo de índices para aproveitar a cache de
+// vértices já transformados da GPU (algoritmo de Tom Forsyth, "Linear-Speed
+// Vertex Cache Optimisation"). "num_vertices" é o número total de vértices
+// referenciados pelos índices.
+void MeshProcessing_OptimizeVertexCache(unsigned int* indices, size_t num_indices, size_t num_vertices);
+
+// Simplifica a malha de um intervalo de índices por colapso de arestas,
+// guiado por métricas de erro quádricas (Garland e Heckbert, "Surface
+// Simplification Using Quadric Error Metrics"), até que restem no máximo
+// "target_num_indices" índices ou nenhum colapso seja possível. Cada vértice
+// removido é substituído por um vizinho já existente, de forma que a malha
+// simplificada referencia os mesmos "vertices". Vértices nas bordas da malha e
+// em costuras de atributos (mesma posição, normais ou coordenadas de textura
+// diferentes) são mantidos.
+void MeshProcessing_Simplify(const std::vector<MeshVertex>& vertices, const unsigned int* indices, size_t num_indices, size_t target_num_indices, std::vector<unsigned int>& result);
+
+// Reordena os vértices na ordem em que são referenciados pelos índices, para
+// que a leitura dos atributos seja a mais sequencial possível, e atualiza os
+// índices. Vértices não referenciados são descartados.
+void MeshProcessing_OptimizeVertexFetch(std::vector<MeshVertex>& vertices, std::vector<unsigned int>& indices);
+
+// Formato compacto de um vértice na GPU (20 bytes), com os atributos
+// intercalados em um único buffer. Veja UploadVirtualSceneToGpu() e as
+// entradas de "shader_vertex.glsl".
+struct SceneVertex
+{
+    float        position[3]; // (location = 0), coordenadas (x,y,z) do modelo
+    unsigned int normal;      // (location = 1), GL_INT_2_10_10_10_REV normalizado
+    unsigned int texcoord;    // (location = 2), dois GL_HALF_FLOAT (u,v)
+};
+
+// Codifica uma normal unitária em três inteiros de 10 bits com sinal
+// normalizados (GL_INT_2_10_10_10_REV), e decodifica de volta
+unsigned int MeshProcessing_PackNormal(const float normal[3]);
+void MeshProcessing_UnpackNormal(unsigned int packed, float normal[3]);
+
+// Codifica duas coordenadas de textura como half floats (GL_HALF_FLOAT)
+unsigned int MeshProcessing_PackTexcoords(float u, float v);
+
+// Um objeto ("shape") de uma malha processada. Os índices de todos os níveis
+// de detalhe ficam em MeshData::indices e são relativos ao primeiro vértice
+// da malha. Níveis inexistentes repetem o último nível gerado.
+#define MESH_SHAPE_NAME_LENGTH 64
+struct MeshShape
+{
+    char         name[MESH_SHAPE_NAME_LENGTH]; // Nome do objeto, terminado em zero
+    float        bbox_min[3]; // Axis-Aligned Bounding Box do objeto, em coordenadas locais
+    float        bbox_max[3];
+    unsigned int num_levels_of_detail;
+    unsigned int first_index[MAX_LEVELS_OF_DETAIL]; // Primeiro índice de cada nível de detalhe
+    unsigned int num_indices[MAX_LEVELS_OF_DETAIL]; // Número de índices de cada nível de detalhe
+};
+
+// Malha de um modelo completo, pronta para ser copiada para a GPU
+struct MeshData
+{
+    std::vector<MeshShape>    shapes;
+    std::vector<SceneVertex>  vertices;
+    std::vector<unsigned int> indices;
+};
+
+// Computa as normais de um modelo .obj como a média das normais dos
+// triângulos que compartilham cada vértice, substituindo as do arquivo.
+void MeshProcessing_ComputeNormals(tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes);
+
+// Constrói a malha de um modelo .obj: une os vértices repetidos, gera os
+// níveis de detalhe de cada objeto, otimiza a ordem dos triângulos e dos
+// vértices e compacta os vértices no formato SceneVertex.
+void MeshProcessing_BuildMesh(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, MeshData& mesh);
+
+#endif // _MESHPROCESSING_H
@@ -0,0 +1,70 @@
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+// Medição do tempo de cada quadro e de cada etapa ("seção") de um quadro. O
+// tempo de CPU de uma seção é medido com o relógio do sistema, e o tempo de
+// GPU com consultas GL_TIME_ELAPSED, cujos resultados são lidos alguns quadros
+// depois, quando já estão disponíveis, para que a CPU nunca espere pela GPU.
+// Os últimos PROFILER_HISTORY valores de cada medida são guardados, e as
+// estatísticas (mínimo, média, percentil 99 e máximo) são calculadas sobre
+// eles. Veja TextRendering_ShowProfiler() em "main.cpp".
+
+// Seções medidas em cada quadro
+#define PROFILER_SIMULATION   0 // Passos da simulação (somente CPU, medidos na thread da simulação)
+#define PROFILER_SCENE        1 // Objetos opacos
+#define PROFILER_SKY          2 // Objetos de fundo (céu)
+#define PROFILER_UPSCALE      3 // Ampliação da cena para a janela (resolução dinâmica)
+#define PROFILER_HUD          4 // Texto
+#define PROFILER_NUM_SECTIONS 5
+
+// Número de quadros guardados no histórico
+#define PROFILER_HISTORY 240
+
+// Estatísticas de uma medida, em milissegundos
+struct ProfilerStats
+{
+    int   count; // Número de valores no histórico (zero se não há medidas)
+    float min;
+    float avg;
+    float p99;
+    float max;
+};
+
+// Cria as consultas da OpenGL. Deve ser chamada após a criação do contexto.
+void Profiler_Init();
+
+// Marca o início de um quadro. O tempo entre duas chamadas é o tempo do quadro.
+void Profiler_BeginFrame();
+
+// Delimitam uma seção do quadro atual. As seções não podem ser aninhadas.
+void Profiler_Begin(int section);
+void Profiler_End(int section);
+
+// Registra o tempo de CPU de uma seção no quadro atual, para seções medidas
+// fora de Profiler_Begin() e Profiler_End(), como as executadas em outra thread
+void Profiler_RecordCpuTime(int section, float milliseconds);
+
+// Tempo atual do relógio utilizado pelo profiler, em milissegundos
+double Profiler_GetTime();
+
+// Número do quadro atual, incrementado por Profiler_BeginFrame()
+int Profiler_GetFrame();
+
+// Tempo de GPU total (soma de todas as seções) do último quadro cujas medidas
+// já foram lidas, em milissegundos. Retorna o número desse quadro, ou -1 se
+// nenhum quadro foi medido.
+int Profiler_GetLastGpuFrameTime(float* milliseconds);
+
+// Nome de uma seção, para exibição
+const char* Profiler_SectionName(int section);
+
+// Estatísticas do tempo dos quadros
+void Profiler_GetFrameStats(ProfilerStats* stats);
+
+// Estatísticas dos tempos de CPU e de GPU de uma seção
+void Profiler_GetSectionStats(int section, ProfilerStats* cpu, ProfilerStats* gpu);
+
+// Estatísticas de um conjunto qualquer de medidas
+void Profiler_ComputeStats(const float* values, int count, ProfilerStats* stats);
+
+#endif // _PROFILER_H
@@ -0,0 +1,66 @@
+#ifndef _PROGRAMCACHE_H
+#define _PROGRAMCACHE_H
+
+#include <cstdint>
+#include <string>
+
+#include <glad/glad.h>
+
+// Cache em disco dos programas de GPU já linkados. O binário de cada
+// programa é obtido do driver com glGetProgramBinary() e, nas execuções
+// seguintes, recriado com glProgramBinary(), sem compilar nem linkar os
+// shaders. Estas funções são da extensão GL_ARB_get_program_binary (OpenGL
+// 4.1), ausente em "glad.h", e são carregadas por ProgramCache_Init().
+//
+// Cada programa é identificado pelo hash dos códigos fonte dos seus shaders
+// (veja ProgramCache_Key()). Os binários só valem para o driver que os gerou,
+// então o arquivo guarda também o fabricante, o renderizador e a versão da
+// OpenGL, e é descartado por inteiro quando algum deles muda.
+// Veja CreateGpuProgramFromSource() em "main.cpp".
+//
+// Layout (little-endian, todos os campos alinhados em 4 bytes):
+//   ProgramCacheHeader
+//   driver[driver_length] (texto, sem '\0')
+//   num_entries vezes: ProgramCacheEntry seguido de "size" bytes do binário
+#define PROGRAM_CACHE_MAGIC   0x474F5250 // "PROG"
+#define PROGRAM_CACHE_VERSION 1
+
+struct ProgramCacheHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int driver_length;
+    unsigned int num_entries;
+};
+
+struct ProgramCacheEntry
+{
+    uint64_t     key;
+    unsigned int format; // Formato do binário, definido pelo driver
+    unsigned int size;
+};
+
+// Lê o arquivo de cache "filename", se existir, e carrega as funções da
+// extensão com "load". Deve ser chamada após a criação do contexto, e somente
+// se o driver suporta a extensão. Sem esta chamada, o cache fica desativado
+// e todos os programas são compilados.
+void ProgramCache_Init(const char* filename, GLADloadproc load);
+
+// Chave de um programa: hash (FNV-1a de 64 bits) dos códigos fonte
+uint64_t ProgramCache_Key(const std::string& vertex_source, const std::string& fragment_source);
+
+// Cria um programa a partir do binário guardado com a chave "key". Retorna
+// zero se não há binário, ou se o driver o rejeita (o binário é descartado).
+GLuint ProgramCache_Load(uint64_t key);
+
+// Pede ao driver que mantenha o binário de um programa ainda não linkado
+void ProgramCache_PrepareProgram(GLuint program_id);
+
+// Guarda o binário de um programa linkado com sucesso
+void ProgramCache_Store(uint64_t key, GLuint program_id);
+
+// Grava o arquivo de cache, se algum binário foi guardado. Somente os
+// programas utilizados nesta execução são mantidos.
+void ProgramCache_Save();
+
+#endif // _PROGRAMCACHE_H
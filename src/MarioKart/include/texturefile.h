@@ -0,0 +1,72 @@
+#ifndef _TEXTUREFILE_H
+#define _TEXTUREFILE_H
+
+#include <string>
+#include <vector>
+
+#include "mappedfile.h"
+#include "textureprocessing.h"
+
+// Formato binário das texturas pré-processadas (".tex"), gerado pelo
+// programa "cooker" (veja "cooker.cpp") a partir das imagens ".jpg"/".png".
+// O arquivo contém a cadeia completa de mipmaps já comprimida em um formato
+// da GPU, e é mapeado em memória pelo jogo, de forma que cada nível é enviado
+// diretamente com glCompressedTexImage2D(), sem decodificação nem geração de
+// mipmaps durante o carregamento.
+//
+// Layout (little-endian, todos os campos alinhados em 4 bytes):
+//   TextureFileHeader
+//   TextureFileLevel  levels[num_levels]
+//   dados comprimidos de cada nível, a partir de levels[i].offset
+#define TEXTURE_FILE_MAGIC   0x5845544B // "KTEX"
+#define TEXTURE_FILE_VERSION 1
+
+// Formatos de compressão suportados
+#define TEXTURE_FORMAT_BC1_SRGB 1 // GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+
+struct TextureFileHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int format;
+    unsigned int width;
+    unsigned int height;
+    unsigned int num_levels;
+};
+
+struct TextureFileLevel
+{
+    unsigned int width;
+    unsigned int height;
+    unsigned int offset; // Posição (em bytes) dos dados a partir do início do arquivo
+    unsigned int size;
+};
+
+// Arquivo ".tex" aberto por TextureFile_Open(). Os ponteiros apontam para
+// dentro do arquivo mapeado e são válidos até TextureFile_Close().
+struct TextureFile
+{
+    const TextureFileHeader* header;
+    const TextureFileLevel*  levels;
+    const unsigned char*     data; // Início do arquivo; veja TextureFileLevel::offset
+
+    MappedFile mapping;
+};
+
+// Nome do arquivo ".tex" correspondente a uma imagem. A extensão original é
+// mantida ("box.jpg" -> "box.jpg.tex"), pois existem imagens com o mesmo
+// nome em formatos diferentes.
+std::string TextureFile_CookedFilename(const char* image_filename);
+
+// Grava os níveis comprimidos ("level_data") de uma cadeia de mipmaps
+// ("levels") em um arquivo ".tex". Retorna false em caso de erro.
+bool TextureFile_Write(const char* filename, unsigned int format, const std::vector<ImageLevel>& levels, const std::vector< std::vector<unsigned char> >& level_data);
+
+// Abre um arquivo ".tex". Retorna false se o arquivo não existe, é inválido,
+// foi gerado por outra versão do formato ou é mais antigo que a imagem
+// "source_filename" da qual foi gerado (se não for NULL).
+bool TextureFile_Open(const char* filename, const char* source_filename, TextureFile& file);
+
+void TextureFile_Close(TextureFile& file);
+
+#endif // _TEXTUREFILE_H
@@ -0,0 +1,30 @@
+#ifndef _TEXTUREPROCESSING_H
+#define _TEXTUREPROCESSING_H
+
+#include <vector>
+
+// Funções de pré-processamento de imagens de textura, executadas offline pelo
+// "cooker" (veja "cooker.cpp" e "texturefile.h").
+
+// Um nível de uma cadeia de mipmaps, com três canais (RGB) de 8 bits por pixel
+// codificados em sRGB
+struct ImageLevel
+{
+    int                        width;
+    int                        height;
+    std::vector<unsigned char> pixels;
+};
+
+// Gera todos os níveis de mipmap de uma imagem RGB, até 1x1. Cada nível é a
+// média de blocos de 2x2 pixels do anterior, calculada em espaço linear (como
+// glGenerateMipmap() faz para texturas sRGB).
+void TextureProcessing_BuildMipChain(const unsigned char* pixels, int width, int height, std::vector<ImageLevel>& levels);
+
+// Comprime um nível no formato BC1 (S3TC DXT1): cada bloco de 4x4 pixels é
+// representado por duas cores RGB 5:6:5 e um índice de 2 bits por pixel, que
+// escolhe entre elas e duas cores intermediárias (8 bytes por bloco, 6 vezes
+// menor que RGB8). Blocos nas bordas de imagens cujas dimensões não são
+// múltiplas de 4 repetem os últimos pixels.
+void TextureProcessing_CompressBC1(const ImageLevel& level, std::vector<unsigned char>& blocks);
+
+#endif // _TEXTUREPROCESSING_H
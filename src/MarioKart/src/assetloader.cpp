@@ -0,0 +1,124 @@
+// Carregamento paralelo de recursos. Veja "assetloader.h".
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "assetloader.h"
+
+// Tarefa de carregamento, identificada pela ordem em que foi submetida
+struct AssetJob
+{
+    int                   sequence;
+    std::function<void()> work;
+    std::function<void()> finish;
+};
+
+static std::vector<std::thread>     g_LoaderThreads;
+static std::mutex                   g_LoaderMutex;
+static std::condition_variable      g_LoaderCondition;
+static std::deque<AssetJob>         g_PendingJobs;   // Aguardando uma thread
+static std::map<int, AssetJob>      g_CompletedJobs; // "work" concluído, aguardando "finish"
+static bool                         g_LoaderStopping = false;
+static int                          g_NumSubmittedJobs = 0;
+static int                          g_NumFinishedJobs = 0;
+
+// Laço de cada thread de carregamento
+static void AssetLoader_ThreadMain()
+{
+    while ( true )
+    {
+        AssetJob job;
+        {
+            std::unique_lock<std::mutex> lock(g_LoaderMutex);
+            g_LoaderCondition.wait(lock, []{ return g_LoaderStopping || !g_PendingJobs.empty(); });
+
+            if ( g_PendingJobs.empty() )
+                return;
+
+            job = g_PendingJobs.front();
+            g_PendingJobs.pop_front();
+        }
+
+        job.work();
+
+        std::lock_guard<std::mutex> lock(g_LoaderMutex);
+        g_CompletedJobs[job.sequence] = job;
+    }
+}
+
+void AssetLoader_Start(unsigned int num_threads)
+{
+    if ( num_threads == 0 )
+        num_threads = std::thread::hardware_concurrency();
+    if ( num_threads == 0 )
+        num_threads = 1;
+
+    g_LoaderStopping = false;
+    for (unsigned int i = 0; i < num_threads; ++i)
+        g_LoaderThreads.push_back(std::thread(AssetLoader_ThreadMain));
+}
+
+void AssetLoader_Submit(const std::function<void()>& work, const std::function<void()>& finish)
+{
+    AssetJob job;
+    job.work   = work;
+    job.finish = finish;
+
+    {
+        std::lock_guard<std::mutex> lock(g_LoaderMutex);
+        job.sequence = g_NumSubmittedJobs++;
+        g_PendingJobs.push_back(job);
+    }
+
+    g_LoaderCondition.notify_one();
+}
+
+bool AssetLoader_Update()
+{
+    while ( true )
+    {
+        AssetJob job;
+        {
+            std::lock_guard<std::mutex> lock(g_LoaderMutex);
+            std::map<int, AssetJob>::iterator it = g_CompletedJobs.find(g_NumFinishedJobs);
+            if ( it == g_CompletedJobs.end() )
+                return g_NumFinishedJobs == g_NumSubmittedJobs;
+
+            job = it->second;
+            g_CompletedJobs.erase(it);
+        }
+
+        job.finish();
+
+        std::lock_guard<std::mutex> lock(g_LoaderMutex);
+        g_NumFinishedJobs += 1;
+    }
+}
+
+void AssetLoader_GetProgress(int* finished, int* total)
+{
+    std::lock_guard<std::mutex> lock(g_LoaderMutex);
+    *finished = g_NumFinishedJobs;
+    *total    = g_NumSubmittedJobs;
+}
+
+unsigned int AssetLoader_NumThreads()
+{
+    return g_LoaderThreads.size();
+}
+
+void AssetLoader_Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_LoaderMutex);
+        g_LoaderStopping = true;
+    }
+    g_LoaderCondition.notify_all();
+
+    for (size_t i = 0; i < g_LoaderThreads.size(); ++i)
+        g_LoaderThreads[i].join();
+    g_LoaderThreads.clear();
+}
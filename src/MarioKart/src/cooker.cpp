@@ -0,0 +1,122 @@
+// Programa que pré-processa ("cozinha") os recursos do jogo. Para cada modelo
+// ".obj" é gerado um arquivo ".mesh" com a malha já pronta para a GPU (veja
+// "meshfile.h"), e para cada imagem é gerado um arquivo ".tex" com a cadeia
+// de mipmaps comprimida (veja "texturefile.h"). O jogo carrega os arquivos
+// pré-processados quando eles existem e estão atualizados, evitando o
+// processamento dos recursos a cada execução.
+//
+// Uso: ./cooker arquivo [arquivo ...]   (ou "make cook")
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+#include <stb_image.h>
+
+#include "meshprocessing.h"
+#include "meshfile.h"
+#include "textureprocessing.h"
+#include "texturefile.h"
+
+// Gera o arquivo ".mesh" de um modelo ".obj"
+bool CookModel(const char* filename)
+{
+    printf("Carregando modelo \"%s\"... ", filename);
+
+    tinyobj::attrib_t                 attrib;
+    std::vector<tinyobj::shape_t>     shapes;
+    std::vector<tinyobj::material_t>  materials;
+    std::string err;
+    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filename, NULL, true);
+
+    if (!err.empty())
+        fprintf(stderr, "\n%s\n", err.c_str());
+
+    if (!ret)
+    {
+        fprintf(stderr, "ERROR: Cannot load model \"%s\".\n", filename);
+        return false;
+    }
+
+    printf("OK.\n");
+
+    MeshData mesh;
+    MeshProcessing_ComputeNormals(attrib, shapes);
+    MeshProcessing_BuildMesh(attrib, shapes, mesh);
+
+    std::string cooked_filename = MeshFile_CookedFilename(filename);
+    if ( !MeshFile_Write(cooked_filename.c_str(), mesh) )
+    {
+        fprintf(stderr, "ERROR: Cannot write \"%s\".\n", cooked_filename.c_str());
+        return false;
+    }
+
+    printf("Gravado \"%s\" (%d objetos, %d vértices, %d índices).\n", cooked_filename.c_str(),
+           (int)mesh.shapes.size(), (int)mesh.vertices.size(), (int)mesh.indices.size());
+    return true;
+}
+
+// Gera o arquivo ".tex" de uma imagem, com todos os níveis de mipmap em BC1
+bool CookTexture(const char* filename)
+{
+    printf("Carregando imagem \"%s\"... ", filename);
+
+    // A imagem é invertida verticalmente, como em LoadTextureImage()
+    stbi_set_flip_vertically_on_load(true);
+    int width;
+    int height;
+    int channels;
+    unsigned char *data = stbi_load(filename, &width, &height, &channels, 3);
+
+    if ( data == NULL )
+    {
+        fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", filename);
+        return false;
+    }
+
+    printf("OK (%dx%d).\n", width, height);
+
+    std::vector<ImageLevel> levels;
+    TextureProcessing_BuildMipChain(data, width, height, levels);
+    stbi_image_free(data);
+
+    std::vector< std::vector<unsigned char> > level_data(levels.size());
+    size_t compressed_size = 0;
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        TextureProcessing_CompressBC1(levels[i], level_data[i]);
+        compressed_size += level_data[i].size();
+    }
+
+    std::string cooked_filename = TextureFile_CookedFilename(filename);
+    if ( !TextureFile_Write(cooked_filename.c_str(), TEXTURE_FORMAT_BC1_SRGB, levels, level_data) )
+    {
+        fprintf(stderr, "ERROR: Cannot write \"%s\".\n", cooked_filename.c_str());
+        return false;
+    }
+
+    printf("Gravado \"%s\" (%d níveis, %d KB).\n", cooked_filename.c_str(), (int)levels.size(), (int)(compressed_size / 1024));
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if ( argc < 2 )
+    {
+        fprintf(stderr, "Uso: %s arquivo [arquivo ...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* extension = strrchr(argv[i], '.');
+        bool is_model = extension != NULL && strcmp(extension, ".obj") == 0;
+
+        if ( !(is_model ? CookModel(argv[i]) : CookTexture(argv[i])) )
+            return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
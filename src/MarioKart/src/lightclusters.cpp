@@ -0,0 +1,128 @@
+// Construção das listas de luzes dos clusters. Veja "lightclusters.h".
+#include <algorithm>
+#include <cmath>
+
+#include <glm/vec4.hpp>
+
+#include "lightclusters.h"
+
+// Fatia de profundidade de um ponto à distância "depth" da câmera
+static int LightClusters_Slice(float depth, float near, float slice_scale)
+{
+    int slice = (int)std::floor(std::log(depth / near) * slice_scale);
+    return std::min(std::max(slice, 0), CLUSTER_SLICES - 1);
+}
+
+// Distância até a câmera do início da fatia "slice"
+static float LightClusters_SliceDepth(int slice, float near, float far)
+{
+    return near * std::pow(far / near, (float)slice / CLUSTER_SLICES);
+}
+
+// Converte uma coordenada NDC para o índice de um tile, entre 0 e "tiles"-1
+static int LightClusters_Tile(float ndc, int tiles)
+{
+    int tile = (int)std::floor((ndc * 0.5f + 0.5f) * tiles);
+    return std::min(std::max(tile, 0), tiles - 1);
+}
+
+void LightClusters_Build(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection, float near, float far, LightClusters& clusters)
+{
+    clusters.offset_count.assign(2 * NUM_CLUSTERS, 0);
+    clusters.indices.clear();
+    clusters.pairs.clear();
+
+    const float slice_scale = CLUSTER_SLICES / std::log(far / near);
+
+    for (size_t i = 0; i < lights.size(); ++i)
+    {
+        const PointLight& light = lights[i];
+        glm::vec4 center = view * glm::vec4(light.position, 1.0f);
+        float radius = light.radius;
+
+        // Distâncias, ao longo do eixo de visão (-z), do início e do fim da
+        // caixa envolvente da luz, recortadas pelos planos near e far
+        float depth_min = std::max(-center.z - radius, near);
+        float depth_max = std::min(-center.z + radius, far);
+        if ( depth_min >= depth_max )
+            continue;
+
+        int slice_min = LightClusters_Slice(depth_min, near, slice_scale);
+        int slice_max = LightClusters_Slice(depth_max, near, slice_scale);
+
+        for (int slice = slice_min; slice <= slice_max; ++slice)
+        {
+            // Parte da caixa envolvente dentro da fatia. A projeção de x/d
+            // e y/d é monótona em x, y e d, então os extremos na tela são
+            // atingidos nos vértices da caixa; o mesmo vale para uma
+            // projeção ortográfica.
+            float near_depth = std::max(depth_min, LightClusters_SliceDepth(slice, near, far));
+            float far_depth  = std::min(depth_max, LightClusters_SliceDepth(slice + 1, near, far));
+
+            float ndc_min_x = 1.0f, ndc_max_x = -1.0f;
+            float ndc_min_y = 1.0f, ndc_max_y = -1.0f;
+            for (int corner = 0; corner < 8; ++corner)
+            {
+                glm::vec4 p = projection * glm::vec4(
+                    center.x + ((corner & 1) ? radius : -radius),
+                    center.y + ((corner & 2) ? radius : -radius),
+                    (corner & 4) ? -far_depth : -near_depth,
+                    1.0f);
+                float x = p.x / p.w;
+                float y = p.y / p.w;
+
+                if ( corner == 0 )
+                {
+                    ndc_min_x = ndc_max_x = x;
+                    ndc_min_y = ndc_max_y = y;
+                }
+                else
+                {
+                    ndc_min_x = std::min(ndc_min_x, x); ndc_max_x = std::max(ndc_max_x, x);
+                    ndc_min_y = std::min(ndc_min_y, y); ndc_max_y = std::max(ndc_max_y, y);
+                }
+            }
+
+            // Luz fora da tela nesta fatia
+            if ( ndc_max_x < -1.0f || ndc_min_x > 1.0f || ndc_max_y < -1.0f || ndc_min_y > 1.0f )
+                continue;
+
+            int tile_min_x = LightClusters_Tile(ndc_min_x, CLUSTER_TILES_X);
+            int tile_max_x = LightClusters_Tile(ndc_max_x, CLUSTER_TILES_X);
+            int tile_min_y = LightClusters_Tile(ndc_min_y, CLUSTER_TILES_Y);
+            int tile_max_y = LightClusters_Tile(ndc_max_y, CLUSTER_TILES_Y);
+
+            for (int y = tile_min_y; y <= tile_max_y; ++y)
+            for (int x = tile_min_x; x <= tile_max_x; ++x)
+            {
+                unsigned int cluster = (slice * CLUSTER_TILES_Y + y) * CLUSTER_TILES_X + x;
+                clusters.pairs.push_back(cluster);
+                clusters.pairs.push_back((unsigned int)i);
+            }
+        }
+    }
+
+    // Ordenação por contagem dos pares pelo cluster: contamos as luzes de
+    // cada cluster, calculamos o início de cada lista e então as preenchemos.
+    // As luzes excedentes a MAX_CLUSTER_LIGHT_INDICES são descartadas.
+    size_t num_pairs = std::min(clusters.pairs.size() / 2, (size_t)MAX_CLUSTER_LIGHT_INDICES);
+
+    for (size_t i = 0; i < num_pairs; ++i)
+        clusters.offset_count[2 * clusters.pairs[2 * i] + 1] += 1;
+
+    unsigned int offset = 0;
+    for (int cluster = 0; cluster < NUM_CLUSTERS; ++cluster)
+    {
+        clusters.offset_count[2 * cluster] = offset;
+        offset += clusters.offset_count[2 * cluster + 1];
+        clusters.offset_count[2 * cluster + 1] = 0;
+    }
+
+    clusters.indices.resize(num_pairs);
+    for (size_t i = 0; i < num_pairs; ++i)
+    {
+        unsigned int* entry = &clusters.offset_count[2 * clusters.pairs[2 * i]];
+        clusters.indices[entry[0] + entry[1]] = clusters.pairs[2 * i + 1];
+        entry[1] += 1;
+    }
+}
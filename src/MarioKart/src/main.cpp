@@ -11,6 +11,8 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
+#include <cstring>
+#include <cstdint>
 
 // Headers abaixo são específicos de C++
 #include <map>
@@ -22,6 +24,12 @@
 #include <sstream>
 #include <stdexcept>
 #include <algorithm>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 // Headers das bibliotecas OpenGL
 #include <glad/glad.h>   // Criação de contexto OpenGL 3.3
@@ -53,6 +61,13 @@ using namespace irrklang;
 // Headers locais, definidos na pasta "include/"
 #include "utils.h"
 #include "matrices.h"
+#include "meshprocessing.h"
+#include "meshfile.h"
+#include "texturefile.h"
+#include "assetloader.h"
+#include "profiler.h"
+#include "programcache.h"
+#include "lightclusters.h"
 
 #define M_PI   3.14159265358979323846
 #define M_PI_2 1.57079632679489661923
@@ -85,22 +100,49 @@ struct ObjModel
 
 
 // Declaração de várias funções utilizadas em main().
-void BuildTrianglesAndAddToVirtualScene(ObjModel*); // Constrói representação de um ObjModel como malha de triângulos para renderização
-void ComputeNormals(ObjModel* model); // Computa normais de um ObjModel, caso não existam.
+void LoadModelAndAddToVirtualScene(const char* filename); // Agenda o carregamento de um modelo, pré-processado (".mesh") se possível, e a sua adição à cena
+void AddMeshToVirtualScene(const MeshShape* shapes, size_t num_shapes, const SceneVertex* vertices, size_t num_vertices, const unsigned int* indices, size_t num_indices); // Adiciona uma malha processada à cena
+void UploadVirtualSceneToGpu(); // Envia para a GPU as malhas de todos os objetos de g_VirtualScene
 void LoadShadersFromFiles(); // Carrega os shaders de vértice e fragmento, criando um programa de GPU
-void LoadTextureImage(const char* filename); // Função que carrega imagens de textura
-void DrawVirtualObject(const char* object_name); // Desenha um objeto armazenado em g_VirtualScene
-GLuint LoadShader_Vertex(const char* filename);   // Carrega um vertex shader
-GLuint LoadShader_Fragment(const char* filename); // Carrega um fragment shader
-void LoadShader(const char* filename, GLuint shader_id); // Função utilizada pelas duas acima
+struct SamplerDesc; // Parâmetros de amostragem de uma textura (definida abaixo)
+int LoadTextureImage(const char* filename, const SamplerDesc& sampler); // Função que carrega imagens de textura
+bool IsExtensionSupported(const char* name); // Verifica se o driver OpenGL suporta uma extensão
+void CreateTextureArrays(); // Agrupa as imagens carregadas em arrays de texturas e os envia para a GPU
+void UpdateMaterialTextureUniforms(); // Informa a cada programa de GPU a textura do seu material
+void ShowLoadingScreen(GLFWwindow* window); // Exibe o progresso do carregamento até que todos os recursos estejam na GPU
+int GetVirtualObjectHandle(const char* object_name); // Resolve o nome de um objeto de g_VirtualScene para o seu índice (handle)
+void DrawVirtualObject(int object_handle, const glm::mat4& model, GLintptr draw_uniforms_offset); // Desenha um objeto armazenado em g_VirtualScene, caso ele seja visível
+void DrawVirtualObjectInstanced(int object_handle, const std::vector<glm::mat4>& models, GLintptr draw_uniforms_offset); // Desenha várias cópias de um objeto com uma única chamada
+void QueueDrawVirtualObject(int material, int object_handle, const glm::mat4& model, bool cull_face = true); // Agenda o desenho de um objeto no quadro atual
+void QueueDrawVirtualObjectInstanced(int material, int object_handle, const std::vector<glm::mat4>* models); // Agenda o desenho de várias cópias de um objeto
+void SubmitDrawCommands(const glm::mat4& view, const glm::mat4& projection); // Desenha os objetos agendados, ordenados por estado e distância
+struct DrawCommand;
+uint64_t ComputeDrawSortKey(const DrawCommand& command, size_t sequence); // Chave de ordenação de um comando de desenho
+void AddToStaticBatch(int material, int object_handle, const glm::mat4& model, bool cull_face = true); // Adiciona um objeto imóvel a um lote estático
+void BuildStaticBatches(); // Une os objetos imóveis de mesmo material em malhas em coordenadas globais
+void QueueDrawStaticBatches(); // Agenda o desenho dos lotes estáticos no quadro atual
+void CreateUniformBuffers(); // Cria o buffer circular de uniform blocks
+void CreateLightBuffers(); // Cria as buffer textures das fontes de luz pontuais
+struct KartState;
+void GatherPointLights(const KartState& kart, float aceleration); // Lista as fontes de luz pontuais do quadro atual
+void UpdateLightClusters(const glm::mat4& view, const glm::mat4& projection, float near, float far, int width, int height); // Constrói e envia para a GPU as listas de luzes dos clusters
+std::string LoadShaderSource(const char* filename, const char* defines = ""); // Lê o código de um shader
+void CompileShader(GLuint shader_id, const std::string& source, const char* name); // Compila um shader
 GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id); // Cria um programa de GPU
+GLuint CreateGpuProgramFromSource(const std::string& vertex_source, const std::string& fragment_source, const char* vertex_name, const char* fragment_name); // Idem, a partir dos códigos, com cache
 void PrintObjModelInfo(ObjModel*); // Função para debugging
+void ExtractFrustumPlanes(const glm::mat4& clip); // Computa os planos do frustum da câmera
+bool IsBoundingBoxVisible(const glm::vec3& bbox_min, const glm::vec3& bbox_max, const glm::mat4& model); // Testa uma AABB contra o frustum
+struct SceneObject;
+int SelectLevelOfDetail(const SceneObject& object, const glm::mat4& model); // Escolhe o nível de detalhe de um objeto pelo seu tamanho na tela
 int check_wall_colision();
 void check_box_colision();
 void TextRendering_Count(GLFWwindow* window);
 void TextRendering_ShowPontuacao(GLFWwindow* window);
 void TextRendering_ShowTimeOut(GLFWwindow* window);
 void TextRendering_GameOver(GLFWwindow* window);
+void TextRendering_ShowCullingStats(GLFWwindow* window);
+void TextRendering_ShowProfiler(GLFWwindow* window);
 
 // Declaração de funções auxiliares para renderizar texto dentro da janela
 // OpenGL. Estas funções estão definidas no arquivo "textrendering.cpp".
@@ -108,6 +150,9 @@ void TextRendering_Init();
 float TextRendering_LineHeight(GLFWwindow* window);
 float TextRendering_CharWidth(GLFWwindow* window);
 void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float x, float y, float scale = 1.0f);
+void TextRendering_Flush();
+int TextRendering_CreateLayout();
+void TextRendering_PrintLayout(GLFWwindow* window, int layout, const char* str, float x, float y, float scale = 1.0f);
 
 // Funções abaixo renderizam como texto na janela OpenGL algumas matrizes e
 // outras informações do programa. Definidas após main().
@@ -125,31 +170,91 @@ void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 
 // Funções que controlam a lógica "não-trivial" do programa
 void do_car_movement(int colision);
+void StepSimulation(); // Avança a simulação em um passo de SIMULATION_STEP segundos
+void StartSimulationThread(double clock); // Inicia a thread da simulação no tempo "clock"
+void StopSimulationThread();
+void SimulationThreadMain(double clock);
+double GetGameTime(); // Tempo da partida, em segundos
+
+// Funções do modo de benchmark (veja g_BenchmarkFrames)
+void CreateOffscreenFramebuffer(int width, int height);
+void UpdateBenchmarkInput();
+void WriteBenchmarkReport(const char* filename, const std::vector<float>& frame_times, double load_time);
+
+// Funções da resolução dinâmica (veja g_ResolutionScale)
+void ResizeSceneFramebuffer(int width, int height);
+void UpdateResolutionScale();
 
 // Definimos uma estrutura que armazenará dados necessários para renderizar
 // cada objeto da cena virtual.
 struct SceneObject
 {
     std::string  name;        // Nome do objeto
-    void*        first_index; // Índice do primeiro vértice dentro do vetor indices[] definido em BuildTrianglesAndAddToVirtualScene()
-    int          num_indices; // Número de índices do objeto dentro do vetor indices[] definido em BuildTrianglesAndAddToVirtualScene()
+    void*        first_index[MAX_LEVELS_OF_DETAIL]; // Posição (em bytes) do primeiro índice de cada nível de detalhe dentro de g_SceneIndices
+    int          num_indices[MAX_LEVELS_OF_DETAIL]; // Número de índices de cada nível de detalhe dentro de g_SceneIndices
+    int          num_levels_of_detail; // Todos os níveis compartilham os vértices do objeto
+    GLint        base_vertex; // Valor somado a cada índice do objeto (primeiro vértice do seu modelo)
     GLenum       rendering_mode; // Modo de rasterização (GL_TRIANGLES, GL_TRIANGLE_STRIP, etc.)
-    GLuint       vertex_array_object_id; // ID do VAO onde estão armazenados os atributos do modelo
     glm::vec3    bbox_min; // Axis-Aligned Bounding Box do objeto
     glm::vec3    bbox_max;
 };
 
 // Abaixo definimos variáveis globais utilizadas em várias funções do código.
 
-// A cena virtual é uma lista de objetos nomeados, guardados em um dicionário (map)
-std::map<std::string, SceneObject> g_VirtualScene;
+// A cena virtual é uma lista de objetos guardados de forma contígua em um
+// vetor. Os nomes dos objetos são traduzidos para índices neste vetor (handles)
+// uma única vez, após o carregamento, através de GetVirtualObjectHandle(); as
+// funções de desenho recebem diretamente estes índices.
+std::vector<SceneObject> g_VirtualScene;
+std::map<std::string, int> g_VirtualSceneHandles; // Nome do objeto -> índice em g_VirtualScene
+
+// Os vértices e índices de todos os objetos de g_VirtualScene ficam em buffers
+// compartilhados, descritos por um único VAO. Os vértices têm o formato
+// compacto SceneVertex (veja "meshprocessing.h"). Os vetores abaixo são
+// preenchidos por AddMeshToVirtualScene() e enviados para a GPU
+// de uma só vez por UploadVirtualSceneToGpu().
+GLuint g_SceneVertexArrayId = 0;
+std::vector<GLuint>      g_SceneIndices;
+std::vector<SceneVertex> g_SceneVertices;
 
 // Razão de proporção da janela (largura/altura). Veja função FramebufferSizeCallback().
 float g_ScreenRatio = 1.0f;
 
-// Para a velocidade não ser diferente em diferentes placas de vídeo
-GLfloat deltaTime = 0.0f;	// Time between current frame and last frame
-GLfloat lastFrame = 0.0f;  	// Time of last frame
+// Tamanho, em pixels, do framebuffer onde cada quadro é exibido: o da janela
+// ou, no benchmark, o de g_OffscreenFramebufferId.
+int g_FramebufferWidth = 800;
+int g_FramebufferHeight = 600;
+
+// Resolução dinâmica: a cena 3D é desenhada em uma região do framebuffer
+// fora da tela g_SceneFramebufferId, g_ResolutionScale vezes menor que o
+// framebuffer de exibição em cada dimensão, e depois ampliada para ele com
+// glBlitFramebuffer(). O texto é desenhado em seguida, na resolução original.
+// A escala é ajustada conforme o tempo de GPU dos quadros medido pelo
+// profiler, para mantê-lo abaixo de DYNAMIC_RESOLUTION_TARGET_MS (com folga
+// para a CPU dentro dos 16,7 ms de um quadro a 60 Hz) mesmo quando a câmera
+// está voltada para os objetos mais caros (veja UpdateResolutionScale()).
+// Com a escala 1, a cena é desenhada diretamente no framebuffer de exibição.
+#define DYNAMIC_RESOLUTION_TARGET_MS 12.0f
+#define DYNAMIC_RESOLUTION_MIN_SCALE 0.5f
+#define DYNAMIC_RESOLUTION_SAMPLES   8
+bool   g_DynamicResolution = true; // Veja a tecla G em KeyCallback()
+float  g_ResolutionScale = 1.0f;
+int    g_ResolutionScaleFrame = 0; // Quadro do profiler em que a escala mudou
+GLuint g_SceneFramebufferId = 0;
+GLuint g_SceneColorBufferId = 0;
+GLuint g_SceneDepthBufferId = 0;
+
+// Para a velocidade não ser diferente em diferentes placas de vídeo, a
+// simulação (colisões e movimento do carro) avança em passos de duração fixa,
+// SIMULATION_STEP segundos, independentes da taxa de quadros: a thread da
+// simulação (veja SimulationThreadMain()) executa quantos passos couberem no
+// tempo decorrido desde a sua última iteração. No máximo MAX_SIMULATION_STEPS
+// passos são executados de uma vez, limitando o custo da simulação quando a
+// máquina está lenta (o jogo fica mais lento, ao invés de travar).
+#define SIMULATION_STEP      (1.0/120.0)
+#define MAX_SIMULATION_STEPS 8
+GLfloat deltaTime = SIMULATION_STEP; // Duração do passo da simulação (constante)
+double  g_SimulationTime = 0.0;      // Tempo da partida já simulado
 
 // "g_LeftMouseButtonPressed = true" se o usuário está com o botão esquerdo do mouse
 // pressionado no momento atual. Veja função MouseButtonCallback().
@@ -168,6 +273,33 @@ bool g_UsePerspectiveProjection = true;
 // Variável que controla se o texto informativo será mostrado na tela.
 bool g_ShowInfoText = true;
 
+// Variável que controla se os contadores do frustum culling serão mostrados na tela.
+bool g_ShowCullingStats = false;
+
+// Variável que controla se os tempos medidos pelo profiler (veja "profiler.h")
+// serão mostrados na tela.
+bool g_ShowProfiler = false;
+
+// Planos do frustum da câmera no sistema de coordenadas global, no formato
+// (a,b,c,d) com normal apontando para dentro. Veja ExtractFrustumPlanes().
+glm::vec4 g_FrustumPlanes[6];
+
+// Posição da câmera e escala vertical da projeção (elemento [1][1] da matriz
+// "projection") no quadro atual, usadas na escolha do nível de detalhe. Veja
+// SelectLevelOfDetail().
+glm::vec4 g_LodCameraPosition;
+float     g_LodProjectionScale = 1.0f;
+
+// Fração mínima da altura da tela ocupada pela esfera envolvente de um objeto
+// para que cada nível de detalhe seja usado: o nível i+1 é escolhido quando o
+// objeto ocupa menos que g_LodScreenFractions[i] da tela.
+const float g_LodScreenFractions[MAX_LEVELS_OF_DETAIL - 1] = { 0.20f, 0.10f, 0.05f };
+
+// Número de objetos (ou instâncias) desenhados e descartados pelo frustum
+// culling no quadro atual.
+int g_DrawnObjects = 0;
+int g_CulledObjects = 0;
+
 
 // Variaveis relativas ao objeto carro principal
 // Car Position
@@ -181,28 +313,311 @@ glm::vec4 g_Car_Front = glm::vec4(cos(g_CameraPhi)*sin(g_CameraTheta),
                                         0.0f);
 
 
-// Teclas pressionadas
-bool key_w_pressed = false;
-bool key_a_pressed = false;
-bool key_s_pressed = false;
-bool key_d_pressed = false;
+// Estado do carro utilizado pela renderização. Como a simulação avança em
+// passos fixos, o estado desenhado em cada quadro é interpolado entre os dois
+// últimos passos (veja InterpolateKartState()), e o movimento fica suave mesmo
+// quando a taxa de quadros não é múltipla da taxa da simulação.
+struct KartState
+{
+    glm::vec4 position;
+    glm::vec4 front;
+    float     pitch;
+};
+
+KartState GetKartState();
+KartState InterpolateKartState(const KartState& a, const KartState& b, float alpha);
 
-bool space_pressed = false;
+// Teclas pressionadas. São escritas pela thread principal, em
+// KeyCallback(), e lidas pela thread da simulação.
+std::atomic<bool> key_w_pressed(false);
+std::atomic<bool> key_a_pressed(false);
+std::atomic<bool> key_s_pressed(false);
+std::atomic<bool> key_d_pressed(false);
+
+std::atomic<bool> space_pressed(false);
 
 bool camera_type = true;
 
-// Variáveis que definem um programa de GPU (shaders). Veja função LoadShadersFromFiles().
-GLuint vertex_shader_id;
-GLuint fragment_shader_id;
-GLuint program_id = 0;
-GLint model_uniform;
-GLint view_uniform;
-GLint projection_uniform;
-GLint object_id_uniform;
-GLint bbox_min_uniform;
-GLint bbox_max_uniform;
-// Número de texturas carregadas pela função LoadTextureImage()
-GLuint g_NumLoadedTextures = 0;
+// Identificadores dos materiais da cena. Cada material é desenhado por um
+// programa de GPU próprio, compilado a partir de "shader_fragment.glsl" com
+// OBJECT_ID definido como o identificador abaixo. Veja LoadShadersFromFiles().
+#define SPHERE 0
+#define BUNNY  1
+#define PLANE  2
+#define MARIO  3
+#define BORDER 4
+#define CENTRAL_SPHERE 5
+#define REGULAR_COW 6
+#define BOX 7
+#define ESTACA 8
+#define GOLDEN_COW 9
+#define NUM_MATERIALS 10
+
+// Estrutura que representa um programa de GPU (shaders). As matrizes e demais
+// parâmetros de cada desenho não são uniforms avulsos, mas sim uniform blocks
+// (veja FrameUniforms e DrawUniforms abaixo). Veja LoadShadersFromFiles().
+struct GpuProgram
+{
+    GLuint program_id;
+};
+
+// Um programa de GPU especializado para cada material, e o programa em uso
+GpuProgram g_MaterialPrograms[NUM_MATERIALS];
+const GpuProgram* g_CurrentProgram = NULL;
+
+// Comando de desenho de um objeto. Os desenhos de cada quadro são acumulados
+// em g_DrawCommands e somente enviados para a GPU em SubmitDrawCommands(),
+// ordenados pela chave "sort_key" (veja ComputeDrawSortKey()): primeiro por
+// passo, depois por material (para que cada programa seja ativado uma única
+// vez), por modo de backface culling e, por fim, da frente para trás.
+struct DrawCommand
+{
+    uint64_t   sort_key;      // Chave de ordenação, computada em SubmitDrawCommands()
+    int        material;      // Material do objeto (índice em g_MaterialPrograms)
+    int        object_handle; // Índice do objeto em g_VirtualScene
+    glm::mat4  model;         // Matriz de modelagem (desenho não instanciado)
+    const std::vector<glm::mat4>* instances; // Matrizes das instâncias, ou NULL
+    bool       cull_face;     // Se o backface culling fica habilitado
+    bool       static_batch;  // Se é um lote estático (vértices em coordenadas globais, "model" identidade)
+    GLintptr   draw_uniforms_offset; // Posição do seu DrawUniforms em g_UniformBufferId
+};
+std::vector<DrawCommand> g_DrawCommands;
+
+// Objetos que nunca se movem são unidos, após o carregamento, em lotes
+// estáticos: uma malha por material (e modo de backface culling), com os
+// vértices já transformados para coordenadas globais. Cada lote é desenhado
+// com uma única chamada e sem nenhuma conta com matrizes por quadro. Veja
+// AddToStaticBatch() e BuildStaticBatches(). Somente materiais cujos shaders
+// não dependem das coordenadas locais do modelo (position_model, bbox_min e
+// bbox_max em "shader_fragment.glsl") podem ser desenhados desta forma.
+struct StaticBatchPart
+{
+    int        material;
+    int        object_handle;
+    glm::mat4  model;
+    bool       cull_face;
+};
+std::vector<StaticBatchPart> g_StaticBatchParts; // Descartadas por BuildStaticBatches()
+
+struct StaticBatch
+{
+    int        material;
+    int        object_handle; // Malha do lote em g_VirtualScene
+    bool       cull_face;
+};
+std::vector<StaticBatch> g_StaticBatches;
+
+// Pontos de ligação (binding points) dos uniform blocks declarados em
+// "shader_vertex.glsl" e "shader_fragment.glsl".
+#define FRAME_UNIFORMS_BINDING 0
+#define DRAW_UNIFORMS_BINDING  1
+
+// Conteúdo do uniform block "FrameUniforms", comum a todos os desenhos de um
+// quadro. O layout segue as regras "std140" do GLSL.
+struct FrameUniforms
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 camera_position; // Posição da câmera, em coordenadas globais
+    glm::vec4 light_direction; // Sentido da fonte de luz, normalizado
+    glm::vec4 cluster_params;  // Veja g_ClusterParams
+};
+
+// Conteúdo do uniform block "DrawUniforms", específico de cada desenho. A
+// matriz das normais é computada na CPU, uma vez por objeto, ao invés de uma
+// vez por vértice no shader; é guardada como mat4 para evitar o preenchimento
+// (padding) das colunas de um mat3 em std140.
+struct DrawUniforms
+{
+    glm::mat4 model;
+    glm::mat4 normal_matrix; // inverse(transpose(model))
+    glm::vec4 bbox_min;
+    glm::vec4 bbox_max;
+    GLint     instanced;     // Se a matriz "model" vem do atributo por instância
+    GLint     padding[3];
+};
+
+// Buffer circular com os uniform blocks. O buffer é dividido em
+// UNIFORM_RING_FRAMES segmentos, um por quadro em andamento: a CPU escreve no
+// segmento de um quadro enquanto a GPU ainda lê os dos quadros anteriores.
+// Cada segmento começa com um FrameUniforms, seguido de um DrawUniforms por
+// comando de desenho, todos alinhados a GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+#define UNIFORM_RING_FRAMES  3
+#define UNIFORM_SEGMENT_SIZE (64*1024)
+GLuint   g_UniformBufferId = 0;
+GLint    g_UniformBufferAlignment = 256;
+int      g_UniformRingFrame = 0;
+GLsync   g_UniformRingFences[UNIFORM_RING_FRAMES];
+
+// Cópia na CPU do segmento sendo preenchido no quadro atual
+std::vector<unsigned char> g_UniformStaging;
+
+// Fontes de luz pontuais da cena (caixas, chama do carro e postes), aplicadas
+// com iluminação "clustered forward" (veja "lightclusters.h"). A cada quadro,
+// GatherPointLights() lista as luzes e UpdateLightClusters() constrói as
+// listas dos clusters e as envia para a GPU em três buffer textures, ligadas
+// a unidades de textura reservadas (veja MAX_TEXTURE_UNITS).
+#define LIGHT_DATA_UNIT     28 // RGBA32F: (posição, raio) e (cor, 0) de cada luz
+#define LIGHT_CLUSTERS_UNIT 29 // RG32UI: (início, número) da lista de cada cluster
+#define LIGHT_INDICES_UNIT  30 // R32UI: índices das luzes de todas as listas
+#define MAX_POINT_LIGHTS    256
+
+// Tamanho de cada buffer, suficiente para o máximo de luzes e de índices
+const GLsizeiptr g_LightBufferSizes[3] =
+{
+    MAX_POINT_LIGHTS * 2 * sizeof(glm::vec4),
+    NUM_CLUSTERS * 2 * sizeof(unsigned int),
+    MAX_CLUSTER_LIGHT_INDICES * sizeof(unsigned int),
+};
+
+GLuint                  g_LightBufferIds[3];
+GLuint                  g_LightTextureIds[3];
+std::vector<PointLight> g_PointLights;
+std::vector<glm::vec4>  g_LightData;
+LightClusters           g_LightClusters;
+
+// Parâmetros para encontrar o cluster de um fragmento (uniform
+// "cluster_params" em shader_fragment.glsl): tiles por pixel em x e y,
+// CLUSTER_SLICES/log(far/near) e a distância do near plane.
+glm::vec4 g_ClusterParams;
+
+// Parâmetros de amostragem de uma textura. Veja LoadTextureImage().
+struct SamplerDesc
+{
+    GLint wrap_mode;  // GL_TEXTURE_WRAP_S e GL_TEXTURE_WRAP_T
+    GLint min_filter; // GL_TEXTURE_MIN_FILTER
+    GLint mag_filter; // GL_TEXTURE_MAG_FILTER
+};
+
+// Texturas aplicadas uma única vez sobre o objeto
+const SamplerDesc SAMPLER_CLAMP  = { GL_CLAMP_TO_EDGE, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR };
+// Texturas que se repetem sobre a superfície (ladrilhadas). Veja g_MaterialUVScale.
+const SamplerDesc SAMPLER_REPEAT = { GL_REPEAT,        GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR };
+
+// Imagem decodificada por uma thread de carregamento, aguardando o envio
+// para a GPU. Veja LoadTextureImage().
+struct DecodedImage
+{
+    bool           compressed; // Se true, a imagem está em "file"; senão, em "data"
+    TextureFile    file;
+    int            width;
+    int            height;
+    int            channels;
+    unsigned char* data;
+};
+
+// Imagens de textura carregadas por LoadTextureImage(), sem repetições. Após
+// o carregamento, as imagens de mesmo tamanho e formato são agrupadas em
+// arrays de texturas (GL_TEXTURE_2D_ARRAY) por CreateTextureArrays(), e cada
+// imagem passa a ser uma camada de um array.
+struct TextureImage
+{
+    std::string                   filename;
+    std::shared_ptr<DecodedImage> image; // Liberada após o envio para a GPU
+    int                           array; // Índice em g_TextureArrays
+    int                           layer; // Camada dentro do array
+};
+
+struct TextureArray
+{
+    GLuint           texture_id;
+    int              width;
+    int              height;
+    bool             compressed;
+    int              num_levels; // Níveis de mipmap gravados no arquivo (somente texturas comprimidas)
+    std::vector<int> images;     // Índices em g_TextureImages, na ordem das camadas
+};
+
+// Uma textura é uma imagem amostrada com certos parâmetros. As texturas
+// cujas imagens estão no mesmo array e que usam os mesmos parâmetros
+// compartilham uma unidade de textura; assim, o número de unidades
+// utilizadas depende do número de tamanhos de imagem diferentes, e não do
+// número de texturas.
+struct Texture
+{
+    int         image;   // Índice em g_TextureImages
+    SamplerDesc sampler;
+    GLint       unit;    // Unidade de textura, definida por CreateTextureArrays()
+};
+
+std::vector<TextureImage> g_TextureImages;
+std::vector<TextureArray> g_TextureArrays;
+std::vector<Texture>      g_Textures;
+
+// As unidades de textura 28 a 30 são reservadas para as fontes de luz (veja
+// LIGHT_DATA_UNIT), e a 31 para a fonte de "textrendering.cpp"
+#define MAX_TEXTURE_UNITS 28
+
+// Textura (índice em g_Textures, retornado por LoadTextureImage()) de cada
+// material, ou -1 se o material não tem textura. Veja
+// UpdateMaterialTextureUniforms().
+int g_MaterialTexture[NUM_MATERIALS] =
+{
+    -1, // SPHERE
+    -1, // BUNNY
+    -1, // PLANE
+    -1, // MARIO
+    -1, // BORDER
+    -1, // CENTRAL_SPHERE
+    -1, // REGULAR_COW
+    -1, // BOX
+    -1, // ESTACA
+    -1, // GOLDEN_COW
+};
+
+// Formato S3TC (BC1) com codificação sRGB, das extensões
+// GL_EXT_texture_compression_s3tc e GL_EXT_texture_sRGB (não incluídas na
+// OpenGL 3.3 core, e portanto ausentes em "glad.h")
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+
+// Se true, LoadTextureImage() utiliza as texturas comprimidas geradas pelo
+// "cooker" (veja "texturefile.h"). Definida em main() conforme o driver.
+bool g_UseCompressedTextures = false;
+
+// Passos de renderização, na ordem em que são desenhados. Os objetos de
+// fundo (o céu) cobrem boa parte da tela mas ficam atrás de todo o resto, então
+// são desenhados por último: o teste de profundidade descarta os seus
+// fragmentos já cobertos por objetos opacos antes do Fragment Shader.
+#define RENDER_PASS_OPAQUE     0
+#define RENDER_PASS_BACKGROUND 1
+
+// Passo de renderização de cada material
+const int g_MaterialRenderPass[NUM_MATERIALS] =
+{
+    RENDER_PASS_BACKGROUND, // SPHERE
+    RENDER_PASS_OPAQUE,     // BUNNY
+    RENDER_PASS_OPAQUE,     // PLANE
+    RENDER_PASS_OPAQUE,     // MARIO
+    RENDER_PASS_OPAQUE,     // BORDER
+    RENDER_PASS_OPAQUE,     // CENTRAL_SPHERE
+    RENDER_PASS_OPAQUE,     // REGULAR_COW
+    RENDER_PASS_OPAQUE,     // BOX
+    RENDER_PASS_OPAQUE,     // ESTACA
+    RENDER_PASS_OPAQUE,     // GOLDEN_COW
+};
+
+// Quantas vezes a textura de cada material se repete em U e V (uniform
+// "uv_scale" em shader_fragment.glsl). Só tem efeito em materiais cujas
+// texturas usam SAMPLER_REPEAT.
+const glm::vec2 g_MaterialUVScale[NUM_MATERIALS] =
+{
+    glm::vec2(1.0f, 1.0f),              // SPHERE
+    glm::vec2(1.0f, 1.0f),              // BUNNY
+    glm::vec2(40.0f, 40.0f),            // PLANE
+    glm::vec2(1.0f, 1.0f),              // MARIO
+    glm::vec2(1.0f/0.035f, 1.0f/0.035f),// BORDER
+    glm::vec2(100.0f, 100.0f),          // CENTRAL_SPHERE
+    glm::vec2(1.0f, 1.0f),              // REGULAR_COW
+    glm::vec2(1.0f, 1.0f),              // BOX
+    glm::vec2(1.0f, 1.0f),              // ESTACA
+    glm::vec2(1.0f, 1.0f),              // GOLDEN_COW
+};
+
+// Buffer com as matrizes "model" de cada instância, ligado ao VAO
+// g_SceneVertexArrayId. Veja DrawVirtualObjectInstanced().
+GLuint g_InstanceBufferId = 0;
 
 float g_Car_aceleration = 1.0f;
 float g_Car_backAceleration = 1.0f;
@@ -218,18 +633,134 @@ GLfloat carBackSpeed;
 #define BOX_AMT 40
 #define CLOUD_AMT 200
 
+// Posição (x,z) de cada caixa em "x" e "y", definida em main() antes do início
+// da simulação e nunca mais alterada, e em "z" se a caixa ainda não foi
+// coletada (1) ou não (0). Somente "z" é alterado pela simulação, e a
+// renderização o lê através de SimulationSnapshot::boxes.
 glm::vec3 coord_vec[BOX_AMT];
 glm::vec3 coord_vec_sky[CLOUD_AMT];
 
+// Matrizes de modelagem das nuvens (que nunca se movem) e das caixas, enviadas
+// para a GPU em uma única chamada de desenho instanciada.
+std::vector<glm::mat4> g_CloudModels;
+std::vector<glm::mat4> g_BoxModels;
+std::vector<glm::mat4> g_VisibleInstances; // Instâncias que sobreviveram ao frustum culling
+
 const int time_out = 60;
 
+// Cópia imutável do estado da simulação, publicada pela thread da simulação
+// após cada lote de passos. A renderização desenha somente a cópia mais
+// recente (g_RenderState) e nunca acessa as variáveis alteradas pela
+// simulação em paralelo (g_Car_*, coord_vec[i].z, main_points). As posições
+// das caixas (coord_vec[i].x e .y) são lidas diretamente, pois são imutáveis
+// após a inicialização; veja coord_vec.
+struct SimulationSnapshot
+{
+    KartState previous;       // Estado do carro antes do último passo
+    KartState current;        // Estado do carro após o último passo
+    float     aceleration;    // g_Car_aceleration após o último passo
+    bool      boxes[BOX_AMT]; // Se cada caixa ainda não foi coletada
+    int       points;         // main_points
+    double    time;           // Tempo da partida já simulado (g_SimulationTime)
+    double    clock;          // Valor de GetGameTime() quando a cópia foi publicada
+    double    accumulator;    // Tempo ainda não simulado, menor que um passo
+    double    step_time;      // Tempo de CPU de todos os passos já executados, em milissegundos
+};
+
+// As cópias são trocadas entre as threads por um "triple buffer" sem travas:
+// a simulação escreve em g_Snapshots[g_SnapshotBack], a renderização lê
+// g_Snapshots[g_SnapshotFront], e cada uma troca atomicamente a sua cópia
+// pela terceira, cujo índice está em g_SnapshotMiddle. Nenhuma das threads
+// espera pela outra. Veja PublishSimulationSnapshot() e
+// AcquireSimulationSnapshot().
+#define SNAPSHOT_INDEX_MASK 3
+#define SNAPSHOT_NEW        4 // A cópia intermediária ainda não foi lida
+SimulationSnapshot g_Snapshots[3];
+std::atomic<int>   g_SnapshotMiddle(1);
+int                g_SnapshotBack = 0;  // Acessado somente pela thread da simulação
+int                g_SnapshotFront = 2; // Acessado somente pela thread de renderização
+
+const SimulationSnapshot* g_RenderState = NULL; // Cópia desenhada no quadro atual
+
+void PublishSimulationSnapshot(const KartState& previous, double clock, double accumulator, double step_time);
+const SimulationSnapshot* AcquireSimulationSnapshot();
+
+std::thread         g_SimulationThread;
+std::atomic<bool>   g_SimulationRunning(false);
+// No benchmark, a simulação não segue o relógio: a cada quadro, ela avança
+// até o tempo do quadro, dado pela renderização em g_SimulationTarget, e a
+// renderização espera a cópia desse tempo. As duas threads dormem em
+// g_SimulationCondition ao invés de esperar ativamente, para não ocupar um
+// núcleo que o driver usaria para desenhar. g_SimulationTarget e o fim da
+// thread (g_SimulationRunning) são alterados com g_SimulationMutex travado.
+std::mutex              g_SimulationMutex;
+std::condition_variable g_SimulationCondition;
+double                  g_SimulationTarget = 0.0;
+
 bool shouldClose = false;
 
+// Modo de benchmark, ativado com "--benchmark N" na linha de comando: a
+// janela fica oculta, a cena é desenhada em um framebuffer fora da tela
+// (g_OffscreenFramebufferId), o kart segue um percurso roteirizado (veja
+// UpdateBenchmarkInput()) e, após N quadros, as estatísticas do tempo dos
+// quadros são gravadas em JSON no arquivo g_BenchmarkOutput. O tempo da
+// partida avança exatamente 1/60 s por quadro, independente da velocidade da
+// máquina, de forma que todas as execuções desenham as mesmas imagens.
+int         g_BenchmarkFrames = 0; // Zero se o modo de benchmark está desativado
+int         g_BenchmarkFrame = 0;  // Quadro atual do benchmark
+const char* g_BenchmarkOutput = "benchmark.json";
+GLuint      g_OffscreenFramebufferId = 0;
+
+// Tempo da partida no início do benchmark: logo após a contagem regressiva,
+// para que o kart já possa andar.
+#define BENCHMARK_START_TIME 4.0
+
 ISoundEngine* engine = createIrrKlangDevice();
 
 
 int main(int argc, const char* argv[])
 {
+    // Argumentos da linha de comando: "--benchmark N" (veja g_BenchmarkFrames),
+    // "--output arquivo.json", e opcionalmente um modelo ".obj" adicional.
+    const char* model_filename = NULL;
+    for (int i = 1; i < argc; ++i)
+    {
+        bool has_value = i + 1 < argc;
+
+        if ( (strcmp(argv[i], "--benchmark") == 0 || strcmp(argv[i], "--output") == 0) && !has_value )
+        {
+            fprintf(stderr, "ERROR: Missing value for option \"%s\".\n", argv[i]);
+            std::exit(EXIT_FAILURE);
+        }
+
+        if ( strcmp(argv[i], "--benchmark") == 0 )
+        {
+            g_BenchmarkFrames = atoi(argv[++i]);
+            if ( g_BenchmarkFrames <= 0 )
+            {
+                fprintf(stderr, "ERROR: Invalid number of benchmark frames \"%s\".\n", argv[i]);
+                std::exit(EXIT_FAILURE);
+            }
+        }
+        else if ( strcmp(argv[i], "--output") == 0 )
+        {
+            g_BenchmarkOutput = argv[++i];
+        }
+        else if ( argv[i][0] == '-' )
+        {
+            fprintf(stderr, "ERROR: Unknown option \"%s\".\n", argv[i]);
+            std::exit(EXIT_FAILURE);
+        }
+        else if ( model_filename == NULL )
+        {
+            model_filename = argv[i];
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: Unexpected argument \"%s\" (only one model can be given).\n", argv[i]);
+            std::exit(EXIT_FAILURE);
+        }
+    }
 
 	if (!engine)
 	{
@@ -237,10 +768,14 @@ int main(int argc, const char* argv[])
 		return 0; // error starting up the engine
 	}
     //engine->play2D("../../media/ophelia.mp3", true);
-    engine->play2D("../../media/race_start.wav");
-    engine->play2D("../../media/playback.wav", true);
+    if ( g_BenchmarkFrames == 0 )
+    {
+        engine->play2D("../../media/race_start.wav");
+        engine->play2D("../../media/playback.wav", true);
+    }
 
-    srand(time(NULL));
+    // No benchmark, as caixas e nuvens ficam sempre nas mesmas posições
+    srand(g_BenchmarkFrames > 0 ? 1 : time(NULL));
     // Inicializamos a biblioteca GLFW, utilizada para criar uma janela do
     // sistema operacional, onde poderemos renderizar com a OpenGL.
 
@@ -273,8 +808,12 @@ int main(int argc, const char* argv[])
         coord_vec_sky[i].x = x_coord;
         coord_vec_sky[i].y = y_coord;
         coord_vec_sky[i].z = z_coord;
+
+        g_CloudModels.push_back(Matrix_Translate(coord_vec_sky[i].x, coord_vec_sky[i].y, coord_vec_sky[i].z));
     }
 
+    g_BoxModels.reserve(BOX_AMT);
+
     int success = glfwInit();
     if (!success)
     {
@@ -293,6 +832,10 @@ int main(int argc, const char* argv[])
     // funções modernas da OpenGL.
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+    // No benchmark a janela existe somente para criar o contexto OpenGL
+    if ( g_BenchmarkFrames > 0 )
+        glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
     // Criamos uma janela do sistema operacional
     GLFWwindow* window;
     window = glfwCreateWindow(800, 600, "INFRun", NULL, NULL);
@@ -332,55 +875,135 @@ int main(int argc, const char* argv[])
 
     printf("GPU: %s, %s, OpenGL %s, GLSL %s\n", vendor, renderer, glversion, glslversion);
 
+    // As texturas comprimidas em BC1 (sRGB) são utilizadas somente se o
+    // driver suporta o formato; caso contrário, as imagens originais são
+    // decodificadas durante o carregamento.
+    g_UseCompressedTextures = IsExtensionSupported("GL_EXT_texture_compression_s3tc")
+                           && (IsExtensionSupported("GL_EXT_texture_sRGB") || IsExtensionSupported("GL_EXT_texture_compression_s3tc_srgb"));
+
+    // Os programas de GPU compilados em execuções anteriores são recriados a
+    // partir dos binários guardados em disco. Veja "programcache.h".
+    if ( IsExtensionSupported("GL_ARB_get_program_binary") )
+        ProgramCache_Init("./programcache.bin", (GLADloadproc) glfwGetProcAddress);
+
     // Carregamos os shaders de vértices e de fragmentos que serão utilizados para renderização.
 
     LoadShadersFromFiles();
+    CreateUniformBuffers();
+    CreateLightBuffers();
+
+    // Inicializamos o código para renderização de texto, utilizado também
+    // pela tela de carregamento.
+    TextRendering_Init();
+
+    // Gravamos os binários dos programas que precisaram ser compilados
+    ProgramCache_Save();
+    Profiler_Init();
+
+    // Imagens e modelos são lidos e processados em paralelo pelas threads de
+    // carregamento, enquanto esta thread exibe a tela de carregamento e envia
+    // para a GPU os recursos que ficam prontos. Veja "assetloader.h".
+    double load_start = glfwGetTime();
+    AssetLoader_Start();
+    stbi_set_flip_vertically_on_load(true);
 
-    LoadTextureImage("./data/Brick_Wall_03.jpg");      // TextureImage0
-    LoadTextureImage("./data/mk_kart/E_main.png");
-    LoadTextureImage("./data/bricks.jpg");
-    LoadTextureImage("./data/bricks.jpg");
+    g_MaterialTexture[PLANE]          = LoadTextureImage("./data/Brick_Wall_03.jpg", SAMPLER_REPEAT);
+    g_MaterialTexture[MARIO]          = LoadTextureImage("./data/mk_kart/E_main.png", SAMPLER_CLAMP);
+    g_MaterialTexture[BORDER]         = LoadTextureImage("./data/bricks.jpg", SAMPLER_REPEAT);
     //LoadTextureImage("./data/tc-earth_daymap_surface.jpg");
-    LoadTextureImage("./data/grama.jpg");
-    LoadTextureImage("./data/cow.jpg");
-    LoadTextureImage("./data/box.jpg");
+    g_MaterialTexture[CENTRAL_SPHERE] = LoadTextureImage("./data/grama.jpg", SAMPLER_REPEAT);
+    g_MaterialTexture[REGULAR_COW]    = LoadTextureImage("./data/cow.jpg", SAMPLER_CLAMP);
+    g_MaterialTexture[BOX]            = LoadTextureImage("./data/box.jpg", SAMPLER_CLAMP);
 
 
 
-    ObjModel planemodel("./data/plane.obj");
-    ComputeNormals(&planemodel);
-    BuildTrianglesAndAddToVirtualScene(&planemodel);
+    LoadModelAndAddToVirtualScene("./data/plane.obj");
 
-    ObjModel mariomodel("./data/mk_kart/mk_kart.obj");
-    ComputeNormals(&mariomodel);
-    BuildTrianglesAndAddToVirtualScene(&mariomodel);
+    LoadModelAndAddToVirtualScene("./data/mk_kart/mk_kart.obj");
 
-    ObjModel spheremodel("./data/sphere.obj");
-    ComputeNormals(&spheremodel);
-    BuildTrianglesAndAddToVirtualScene(&spheremodel);
+    LoadModelAndAddToVirtualScene("./data/sphere.obj");
 
-    ObjModel cowmodel("./data/cow.obj");
-    ComputeNormals(&cowmodel);
-    BuildTrianglesAndAddToVirtualScene(&cowmodel);
+    LoadModelAndAddToVirtualScene("./data/cow.obj");
 
-    ObjModel cubemodel("./data/cube.obj");
-    ComputeNormals(&cubemodel);
-    BuildTrianglesAndAddToVirtualScene(&cubemodel);
+    LoadModelAndAddToVirtualScene("./data/cube.obj");
 
-    ObjModel cilindermodel("./data/cilinder.obj");
-    ComputeNormals(&cilindermodel);
-    BuildTrianglesAndAddToVirtualScene(&cilindermodel);
+    LoadModelAndAddToVirtualScene("./data/cilinder.obj");
 
-    //PrintObjModelInfo(&mariomodel);
+    // O modelo adicional da linha de comando é carregado junto com os demais,
+    // para que a sua malha também seja enviada por UploadVirtualSceneToGpu()
+    if ( model_filename != NULL )
+        LoadModelAndAddToVirtualScene(model_filename);
 
-    if ( argc > 1 )
-    {
-        ObjModel model(argv[1]);
-        BuildTrianglesAndAddToVirtualScene(&model);
-    }
+    ShowLoadingScreen(window);
+    CreateTextureArrays();
+    UpdateMaterialTextureUniforms();
 
-    // Inicializamos o código para renderização de texto.
-    TextRendering_Init();
+    double load_time = glfwGetTime() - load_start;
+    printf("Recursos carregados em %.2f segundos (%u threads).\n", load_time, AssetLoader_NumThreads());
+    AssetLoader_Stop();
+
+    // Resolvemos os nomes dos objetos que serão desenhados para os seus
+    // índices em g_VirtualScene, evitando buscas por nome a cada quadro.
+    const int plane_object    = GetVirtualObjectHandle("plane");
+    const int mario_object    = GetVirtualObjectHandle("mario");
+    const int sphere_object   = GetVirtualObjectHandle("sphere");
+    const int cow_object      = GetVirtualObjectHandle("cow");
+    const int cube_object     = GetVirtualObjectHandle("cube");
+    const int cilinder_object = GetVirtualObjectHandle("cilinder");
+
+    // Cenário imóvel, unido em lotes estáticos antes do envio para a GPU
+    AddToStaticBatch(PLANE, plane_object, Matrix_Translate(0.0f, -1.0f,0.0f)
+                                        * Matrix_Scale(50.0f,50.0f,50.0f));
+
+    // Objetos abaixo são visíveis pelos dois lados (sem backface culling)
+    AddToStaticBatch(SPHERE, sphere_object, Matrix_Translate(0.0f, -250.0f, 0.0f)
+                                          * Matrix_Scale(500.0f, 500.0f, 500.0f), false);
+
+    AddToStaticBatch(BORDER, plane_object, Matrix_Translate(0.0f, -48.75f, 50.0f)
+                                         * Matrix_Scale(50.0f,50.0f,50.0f)
+                                         * Matrix_Rotate_X(M_PI_2), false);
+
+    AddToStaticBatch(BORDER, plane_object, Matrix_Translate(0.0f,  -48.75f,-50.0f)
+                                         * Matrix_Scale(50.0f,50.0f,50.0f)
+                                         * Matrix_Rotate_X(M_PI_2), false);
+
+    AddToStaticBatch(BORDER, plane_object, Matrix_Translate(50.0f,  -48.75f,0.0f)
+                                         * Matrix_Scale(50.0f,50.0f,50.0f)
+                                         * Matrix_Rotate_Y(M_PI_2)
+                                         * Matrix_Rotate_X(M_PI_2), false);
+
+    AddToStaticBatch(BORDER, plane_object, Matrix_Translate(-50.0f,  -48.75f,0.0f)
+                                         * Matrix_Scale(50.0f,50.0f,50.0f)
+                                         * Matrix_Rotate_Y(M_PI_2)
+                                         * Matrix_Rotate_X(M_PI_2), false);
+
+    AddToStaticBatch(ESTACA, cube_object, Matrix_Translate(42.0f, 0.0f, -42.0f)
+                                        * Matrix_Scale(0.10f,2.0f,0.10f));
+
+    AddToStaticBatch(ESTACA, cube_object, Matrix_Translate(48.0f, 0.0f, -42.0f)
+                                        * Matrix_Scale(0.10f,2.0f,0.10f));
+
+    AddToStaticBatch(GOLDEN_COW, cow_object, Matrix_Translate(48.0f, 0.2f, -20.0f)
+                                           * Matrix_Scale(2.0f,2.0f,2.0f)
+                                           * Matrix_Rotate_Y(-M_PI_2));
+
+    BuildStaticBatches();
+
+    UploadVirtualSceneToGpu();
+
+    // Os objetos imóveis cujos materiais usam as coordenadas locais do modelo
+    // (veja StaticBatch) continuam sendo desenhados um a um, mas as suas
+    // matrizes de modelagem são computadas uma única vez.
+    const glm::mat4 central_sphere_model = Matrix_Translate(0.0f, -113.0f, 0.0f)
+                                         * Matrix_Scale(120.0f, 120.0f, 120.0f);
+
+    const glm::mat4 banner_model = Matrix_Translate(45.0f, 1.5f, -42.0f)
+                                 * Matrix_Scale(3.0f,0.5f,1.0f)
+                                 * Matrix_Rotate_X(M_PI_2);
+
+    const glm::mat4 regular_cow_model = Matrix_Translate(25.0f,0.55f, 25.0f)
+                                      * Matrix_Rotate_Y(-M_PI_2/2)
+                                      * Matrix_Rotate(-M_PI_2/6, glm::vec4(1.0f, 0.0f, 1.0f, 0.0f));
 
     // Habilitamos o Z-buffer.
     glEnable(GL_DEPTH_TEST);
@@ -395,24 +1018,90 @@ int main(int argc, const char* argv[])
     glm::mat4 the_model;
     glm::mat4 the_view;
 
+    // O tempo da partida (contagem regressiva, tempo limite) começa a contar
+    // somente após o carregamento.
+    glfwSetTime(0.0);
+    StartSimulationThread(GetGameTime());
+
+    // Número de caixas coletadas cujo som já foi tocado
+    int played_points = 0;
+
+    // Valor de SimulationSnapshot::step_time já registrado pelo profiler
+    double recorded_step_time = 0.0;
+
+    // Tempo de cada quadro do benchmark, em milissegundos
+    std::vector<float> benchmark_frame_times;
+    if ( g_BenchmarkFrames > 0 )
+    {
+        // A escala da resolução dependeria da velocidade da máquina, e as
+        // imagens não seriam sempre as mesmas
+        g_DynamicResolution = false;
+
+        CreateOffscreenFramebuffer(800, 600);
+        benchmark_frame_times.reserve(g_BenchmarkFrames);
+        printf("Benchmark: %d quadros.\n", g_BenchmarkFrames);
+    }
+
     // Ficamos em loop, renderizando, até que o usuário feche a janela
     while (!shouldClose)
     {
+        double frame_start = Profiler_GetTime();
+        Profiler_BeginFrame();
+
+        if ( g_BenchmarkFrames > 0 )
+            UpdateBenchmarkInput();
+
         // Aqui executamos as operações de renderização
 
+        // Resolução em que a cena é desenhada neste quadro
+        UpdateResolutionScale();
+        int scene_width  = std::max(1, (int)(g_FramebufferWidth * g_ResolutionScale + 0.5f));
+        int scene_height = std::max(1, (int)(g_FramebufferHeight * g_ResolutionScale + 0.5f));
+        bool scaled = scene_width != g_FramebufferWidth || scene_height != g_FramebufferHeight;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, scaled ? g_SceneFramebufferId : g_OffscreenFramebufferId);
+        glViewport(0, 0, scene_width, scene_height);
+
         // Definimos a cor do "fundo" do framebuffer como branco.
         glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 
-        // "Pintamos" todos os pixels do framebuffer com a cor definida acima, e também resetamos o Z-buffer
+        // "Pintamos" todos os pixels do framebuffer com a cor definida acima, e também resetamos o Z-buffer.
+        // Somente a região utilizada pela cena é limpa.
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(0, 0, scene_width, scene_height);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glDisable(GL_SCISSOR_TEST);
 
-        // Pedimos para a GPU utilizar o programa de GPU criado acima
-        glUseProgram(program_id);
+        // Obtemos o estado mais recente publicado pela simulação. No
+        // benchmark, esperamos a simulação alcançar o tempo do quadro, para
+        // que todas as execuções desenhem as mesmas imagens.
+        double currentFrame = GetGameTime();
+
+        if ( g_BenchmarkFrames > 0 )
+        {
+            std::unique_lock<std::mutex> lock(g_SimulationMutex);
+            g_SimulationTarget = currentFrame;
+            g_SimulationCondition.notify_all();
+            g_SimulationCondition.wait(lock, [&]() { return AcquireSimulationSnapshot()->clock == currentFrame; });
+        }
+        g_RenderState = AcquireSimulationSnapshot();
+
+        // Os passos são medidos pela thread da simulação; atribuímos a este
+        // quadro o tempo dos passos publicados desde o quadro anterior, pois
+        // as cópias intermediárias podem ter sido descartadas.
+        Profiler_RecordCpuTime(PROFILER_SIMULATION, (float)(g_RenderState->step_time - recorded_step_time));
+        recorded_step_time = g_RenderState->step_time;
 
-        // Manter a mesma velocidade em diferentes sistemas (GPUS)
-        GLfloat currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        // O áudio é acessado somente por esta thread
+        if ( g_RenderState->points > played_points )
+            engine->play2D("../../media/box_colision.wav");
+        played_points = g_RenderState->points;
+
+        // Estado do carro desenhado neste quadro, entre os dois últimos
+        // passos, considerando também o tempo desde a publicação da cópia.
+        double unsimulated = g_RenderState->accumulator + (currentFrame - g_RenderState->clock);
+        float alpha = std::min(std::max((float)(unsimulated / SIMULATION_STEP), 0.0f), 1.0f);
+        KartState kart = InterpolateKartState(g_RenderState->previous, g_RenderState->current, alpha);
 
         // Computamos a posição da câmera utilizando coordenadas esféricas veja as funções CursorPosCallback() e ScrollCallback().
         glm::mat4 view;
@@ -424,9 +1113,9 @@ int main(int argc, const char* argv[])
 
             // Abaixo definimos as varáveis que efetivamente definem a câmera virtual.
 
-            glm::vec4 camera_lookat_l    = glm::vec4(g_Car_Position.x,g_Car_Position.y,g_Car_Position.z,1.0f); // Ponto "l", para onde a câmera (look-at) estará sempre olhando
-            glm::vec4 oposite_escalated  = glm::vec4(r*g_Car_Front.x, r*g_Car_Front.y,r*g_Car_Front.z, 0.0f);
-            glm::vec4 camera_position_c  = g_Car_Position - oposite_escalated + glm::vec4(0.0f,2.0f,0.0f,0.0f); // Ponto "c", centro da câmera
+            glm::vec4 camera_lookat_l    = glm::vec4(kart.position.x,kart.position.y,kart.position.z,1.0f); // Ponto "l", para onde a câmera (look-at) estará sempre olhando
+            glm::vec4 oposite_escalated  = glm::vec4(r*kart.front.x, r*kart.front.y,r*kart.front.z, 0.0f);
+            glm::vec4 camera_position_c  = kart.position - oposite_escalated + glm::vec4(0.0f,2.0f,0.0f,0.0f); // Ponto "c", centro da câmera
             glm::vec4 camera_view_vector = camera_lookat_l - camera_position_c; // Vetor "view", sentido para onde a câmera está virada
             glm::vec4 camera_up_vector   = glm::vec4(0.0f,1.0f,0.0f,0.0f); // Vetor "up"
 
@@ -436,9 +1125,9 @@ int main(int argc, const char* argv[])
         else {
 
             // Abaixo definimos as varáveis que efetivamente definem a câmera virtual.
-            glm::vec4 camera_position_c  = glm::vec4(g_Car_Position.x + 2.5f * deltaTime*g_Car_Front.x *g_Car_aceleration, g_Car_Position.y + 0.85, g_Car_Position.z + 2.5f * deltaTime*g_Car_Front.z *g_Car_aceleration ,1.0f); // Ponto "c", centro da câmera
+            glm::vec4 camera_position_c  = glm::vec4(kart.position.x + 2.5f * deltaTime*kart.front.x *g_RenderState->aceleration, kart.position.y + 0.85, kart.position.z + 2.5f * deltaTime*kart.front.z *g_RenderState->aceleration ,1.0f); // Ponto "c", centro da câmera
             //glm::vec4 camera_lookat_l    = glm::vec4(0.0f,0.0f,0.0f,1.0f); // Ponto "l", para onde a câmera (look-at) estará sempre olhando
-            glm::vec4 camera_view_vector = g_Car_Front; // Vetor "view", sentido para onde a câmera está virada
+            glm::vec4 camera_view_vector = kart.front; // Vetor "view", sentido para onde a câmera está virada
             glm::vec4 camera_up_vector   = glm::vec4(0.0f,1.0f,0.0f,0.0f); // Vetor "up"
 
             // Computamos a matriz "View" e a matriz de Projeção.
@@ -469,169 +1158,285 @@ int main(int argc, const char* argv[])
 
         glm::mat4 model = Matrix_Identity(); // Transformação identidade de modelagem
 
-        // Enviamos as matrizes "view" e "projection" para a placa de vídeo
-        // (GPU). Veja o arquivo "shader_vertex.glsl", onde estas são
-        // efetivamente aplicadas em todos os pontos.
-        glUniformMatrix4fv(view_uniform       , 1 , GL_FALSE , glm::value_ptr(view));
-        glUniformMatrix4fv(projection_uniform , 1 , GL_FALSE , glm::value_ptr(projection));
-
-
-
-        check_box_colision();
-        int colision = check_wall_colision();
-
-        if (glfwGetTime() > 3.61f && glfwGetTime() <= time_out+3.61f)
-            do_car_movement(colision);
-
-        #define SPHERE 0
-        #define BUNNY  1
-        #define PLANE  2
-        #define MARIO  3
-        #define BORDER 4
-        #define CENTRAL_SPHERE 5
-        #define REGULAR_COW 6
-        #define BOX 7
-        #define ESTACA 8
-        #define GOLDEN_COW 9
-
-        model = Matrix_Translate(0.0f, -1.0f,0.0f)
-              * Matrix_Scale(50.0f,50.0f,50.0f);
-        glUniformMatrix4fv(model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(object_id_uniform, PLANE);
-        DrawVirtualObject("plane");
-
-
-        model = Matrix_Translate(g_Car_Position.x, g_Car_Position.y, g_Car_Position.z)
-              * Matrix_Rotate_Y(g_Car_Pitch);
-        glUniformMatrix4fv(model_uniform, 1 , GL_FALSE, glm::value_ptr(model));
-        glUniform1i(object_id_uniform, MARIO);
-        DrawVirtualObject("mario");
-
-        model = Matrix_Translate(0.0f, -113.0f, 0.0f)
-              * Matrix_Scale(120.0f, 120.0f, 120.0f);
-        glUniformMatrix4fv(model_uniform, 1 , GL_FALSE, glm::value_ptr(model));
-        glUniform1i(object_id_uniform, CENTRAL_SPHERE);
-        DrawVirtualObject("sphere");
-
-
-        glDisable(GL_CULL_FACE);
-        model = Matrix_Translate(0.0f, -250.0f, 0.0f)
-              * Matrix_Scale(500.0f, 500.0f, 500.0f);
-        glUniformMatrix4fv(model_uniform, 1 , GL_FALSE, glm::value_ptr(model));
-        glUniform1i(object_id_uniform, SPHERE);
-        DrawVirtualObject("sphere");
-
-        model = Matrix_Translate(0.0f, -48.75f, 50.0f)
-              * Matrix_Scale(50.0f,50.0f,50.0f)
-              * Matrix_Rotate_X(M_PI_2);
-        glUniformMatrix4fv(model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(object_id_uniform, BORDER);
-        DrawVirtualObject("plane");
-
-
-        model = Matrix_Translate(0.0f,  -48.75f,-50.0f)
-              * Matrix_Scale(50.0f,50.0f,50.0f)
-              * Matrix_Rotate_X(M_PI_2);
-        glUniformMatrix4fv(model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(object_id_uniform, BORDER);
-        DrawVirtualObject("plane");
-
-        model = Matrix_Translate(50.0f,  -48.75f,0.0f)
-              * Matrix_Scale(50.0f,50.0f,50.0f)
-              * Matrix_Rotate_Y(M_PI_2)
-              * Matrix_Rotate_X(M_PI_2);
-        glUniformMatrix4fv(model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(object_id_uniform, BORDER);
-        DrawVirtualObject("plane");
-
-        model = Matrix_Translate(-50.0f,  -48.75f,0.0f)
-              * Matrix_Scale(50.0f,50.0f,50.0f)
-              * Matrix_Rotate_Y(M_PI_2)
-              * Matrix_Rotate_X(M_PI_2);
-        glUniformMatrix4fv(model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(object_id_uniform, BORDER);
-        DrawVirtualObject("plane");
-
-        model = Matrix_Translate(45.0f, 1.5f, -42.0f)
-              * Matrix_Scale(3.0f,0.5f,1.0f)
-              * Matrix_Rotate_X(M_PI_2);
-        glUniformMatrix4fv(model_uniform, 1 , GL_FALSE, glm::value_ptr(model));
-        glUniform1i(object_id_uniform, REGULAR_COW);
-        DrawVirtualObject("plane");
+        // Os desenhos deste quadro são agendados abaixo e enviados para a GPU
+        // em SubmitDrawCommands(), junto com as matrizes "view" e "projection".
+        g_DrawCommands.clear();
 
-        glEnable(GL_CULL_FACE);
+        // Planos do frustum utilizados para descartar, antes de desenhar, os
+        // objetos que estão fora do campo de visão da câmera.
+        ExtractFrustumPlanes(projection * view);
+        g_DrawnObjects = 0;
+        g_CulledObjects = 0;
+
+        QueueDrawStaticBatches();
+
+        model = Matrix_Translate(kart.position.x, kart.position.y, kart.position.z)
+              * Matrix_Rotate_Y(kart.pitch);
+        QueueDrawVirtualObject(MARIO, mario_object, model);
 
-        model = Matrix_Translate(25.0f,0.55f, 25.0f)
-            * Matrix_Rotate_Y(-M_PI_2/2)
-            * Matrix_Rotate(-M_PI_2/6, glm::vec4(1.0f, 0.0f, 1.0f, 0.0f));
-        glUniformMatrix4fv(model_uniform, 1 , GL_FALSE, glm::value_ptr(model));
-        glUniform1i(object_id_uniform, REGULAR_COW);
-        DrawVirtualObject("cow");
+        QueueDrawVirtualObject(CENTRAL_SPHERE, sphere_object, central_sphere_model);
 
+        QueueDrawVirtualObject(REGULAR_COW, plane_object, banner_model, false);
+
+        QueueDrawVirtualObject(REGULAR_COW, cow_object, regular_cow_model);
+
+        // Todas as caixas ainda não coletadas giram juntas, então a rotação é
+        // calculada uma única vez por quadro.
+        glm::mat4 box_rotation = Matrix_Scale(0.35f,0.35f,0.35f)
+                               * Matrix_Rotate(g_AngleY + (float)GetGameTime() * 1.5f, glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+        g_BoxModels.clear();
         for (int i=0; i < BOX_AMT; i ++) {
 
-            if (coord_vec[i].z == 1) {
-                model = Matrix_Translate(coord_vec[i].x, 0.0f, coord_vec[i].y)
-                      * Matrix_Scale(0.35f,0.35f,0.35f)
-                      * Matrix_Rotate(g_AngleY + (float)glfwGetTime() * 1.5f, glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
-                glUniformMatrix4fv(model_uniform, 1 , GL_FALSE, glm::value_ptr(model));
-                glUniform1i(object_id_uniform, BOX);
-                DrawVirtualObject("cube");
-            }
+            if (g_RenderState->boxes[i])
+                g_BoxModels.push_back(Matrix_Translate(coord_vec[i].x, 0.0f, coord_vec[i].y) * box_rotation);
         }
+        QueueDrawVirtualObjectInstanced(BOX, cube_object, &g_BoxModels);
 
-        for (int i=0; i < CLOUD_AMT; i++) {
+        QueueDrawVirtualObjectInstanced(REGULAR_COW, cilinder_object, &g_CloudModels);
 
-            model = Matrix_Translate(coord_vec_sky[i].x, coord_vec_sky[i].y,  coord_vec_sky[i].z);
-            glUniformMatrix4fv(model_uniform, 1 , GL_FALSE, glm::value_ptr(model));
-            glUniform1i(object_id_uniform, REGULAR_COW);
-            DrawVirtualObject("cilinder");
-        }
+        GatherPointLights(kart, g_RenderState->aceleration);
+        UpdateLightClusters(view, projection, -nearplane, -farplane, scene_width, scene_height);
 
-        model = Matrix_Translate(42.0f, 0.0f, -42.0f)
-              * Matrix_Scale(0.10f,2.0f,0.10f);
-        glUniformMatrix4fv(model_uniform, 1 , GL_FALSE, glm::value_ptr(model));
-        glUniform1i(object_id_uniform, ESTACA);
-        DrawVirtualObject("cube");
+        SubmitDrawCommands(view, projection);
 
-        model = Matrix_Translate(48.0f, 0.0f, -42.0f)
-              * Matrix_Scale(0.10f,2.0f,0.10f);
-        glUniformMatrix4fv(model_uniform, 1 , GL_FALSE, glm::value_ptr(model));
-        glUniform1i(object_id_uniform, ESTACA);
-        DrawVirtualObject("cube");
+        // Ampliamos a cena para o framebuffer de exibição, onde o texto é
+        // desenhado na resolução original
+        if ( scaled )
+        {
+            Profiler_Begin(PROFILER_UPSCALE);
 
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, g_SceneFramebufferId);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, g_OffscreenFramebufferId);
+            glBlitFramebuffer(0, 0, scene_width, scene_height, 0, 0, g_FramebufferWidth, g_FramebufferHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            glBindFramebuffer(GL_FRAMEBUFFER, g_OffscreenFramebufferId);
+            glViewport(0, 0, g_FramebufferWidth, g_FramebufferHeight);
 
-        model = Matrix_Translate(48.0f, 0.2f, -20.0f)
-              * Matrix_Scale(2.0f,2.0f,2.0f)
-              * Matrix_Rotate_Y(-M_PI_2);
-        glUniformMatrix4fv(model_uniform, 1 , GL_FALSE, glm::value_ptr(model));
-        glUniform1i(object_id_uniform, GOLDEN_COW);
-        DrawVirtualObject("cow");
+            Profiler_End(PROFILER_UPSCALE);
+        }
 
         // Imprimimos na tela informação sobre os frames per second
         //TextRendering_ShowFramesPerSecond(window);
         shouldClose = glfwWindowShouldClose(window);
 
-        if (glfwGetTime() >= time_out + 3.61 + 5)
+        if (GetGameTime() >= time_out + 3.61 + 5 && g_BenchmarkFrames == 0)
             shouldClose = true;
 
 
+        Profiler_Begin(PROFILER_HUD);
+
         TextRendering_Count(window);
         TextRendering_ShowPontuacao(window);
         TextRendering_ShowTimeOut(window);
         TextRendering_GameOver(window);
+        TextRendering_ShowCullingStats(window);
+        TextRendering_ShowProfiler(window);
 
+        // Desenhamos todo o texto do quadro com uma única chamada
+        TextRendering_Flush();
 
+        Profiler_End(PROFILER_HUD);
 
-        glfwSwapBuffers(window);
+        if ( g_BenchmarkFrames > 0 )
+        {
+            // Esperamos a GPU terminar o quadro, para que o tempo medido
+            // inclua toda a renderização e não somente o envio dos comandos.
+            glFinish();
+            benchmark_frame_times.push_back((float)(Profiler_GetTime() - frame_start));
+
+            g_BenchmarkFrame += 1;
+            if ( g_BenchmarkFrame >= g_BenchmarkFrames )
+                shouldClose = true;
+        }
+        else
+        {
+            glfwSwapBuffers(window);
+        }
 
         glfwPollEvents();
     }
+
+    StopSimulationThread();
+
+    if ( g_BenchmarkFrames > 0 )
+        WriteBenchmarkReport(g_BenchmarkOutput, benchmark_frame_times, load_time);
+
     engine->drop(); // delete engine
     glfwTerminate();
     return 0;
 }
 
+// Avança a simulação em um passo de SIMULATION_STEP segundos: testa as
+// colisões e, durante a partida, movimenta o carro.
+void StepSimulation()
+{
+    check_box_colision();
+    int colision = check_wall_colision();
+
+    if (g_SimulationTime > 3.61f && g_SimulationTime <= time_out+3.61f)
+        do_car_movement(colision);
+
+    g_SimulationTime += SIMULATION_STEP;
+}
+
+// Inicia a thread da simulação, com o relógio da partida valendo "clock". O
+// estado inicial é publicado antes, para que o primeiro quadro já o encontre.
+// A thread também é encerrada por atexit(): um std::exit() por erro fatal com
+// ela ainda em execução destruiria g_SimulationThread sem join(), o que
+// aborta o programa (std::terminate).
+void StartSimulationThread(double clock)
+{
+    g_SimulationTime = clock;
+    g_SimulationTarget = clock;
+    PublishSimulationSnapshot(GetKartState(), clock, 0.0, 0.0);
+
+    g_SimulationRunning = true;
+    g_SimulationThread = std::thread(SimulationThreadMain, clock);
+    std::atexit(StopSimulationThread);
+}
+
+// Encerra a thread da simulação, se ela estiver em execução
+void StopSimulationThread()
+{
+    if ( !g_SimulationThread.joinable() )
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(g_SimulationMutex);
+        g_SimulationRunning = false;
+    }
+    g_SimulationCondition.notify_all();
+
+    g_SimulationThread.join();
+}
+
+// Laço da thread da simulação: executa os passos correspondentes ao tempo
+// decorrido desde a iteração anterior, publica o estado resultante e dorme
+// até o próximo passo. Assim, um quadro demorado não atrasa a simulação. As
+// teclas, porém, continuam sendo lidas por glfwPollEvents() na thread de
+// renderização (a GLFW exige a thread principal), então durante um quadro
+// demorado a simulação avança com o estado das teclas do quadro anterior.
+void SimulationThreadMain(double clock)
+{
+    double    accumulator = 0.0;
+    double    step_time = 0.0; // Veja SimulationSnapshot::step_time
+    KartState previous = GetKartState();
+
+    while ( g_SimulationRunning )
+    {
+        double now;
+        if ( g_BenchmarkFrames > 0 )
+        {
+            // Esperamos a renderização pedir o próximo quadro
+            std::unique_lock<std::mutex> lock(g_SimulationMutex);
+            g_SimulationCondition.wait(lock, [&]() { return g_SimulationTarget != clock || !g_SimulationRunning; });
+            if ( !g_SimulationRunning )
+                break;
+            now = g_SimulationTarget;
+        }
+        else
+        {
+            now = GetGameTime();
+            if ( now == clock )
+            {
+                std::this_thread::yield();
+                continue;
+            }
+        }
+
+        accumulator += std::min(now - clock, MAX_SIMULATION_STEPS * SIMULATION_STEP);
+        clock = now;
+
+        // A pequena tolerância evita que erros de arredondamento no tempo
+        // alternem iterações com um passo a menos e um passo a mais.
+        while ( accumulator >= SIMULATION_STEP - 1e-7 )
+        {
+            previous = GetKartState();
+
+            double step_start = Profiler_GetTime();
+            StepSimulation();
+            step_time += Profiler_GetTime() - step_start;
+
+            accumulator -= SIMULATION_STEP;
+        }
+
+        PublishSimulationSnapshot(previous, clock, accumulator, step_time);
+
+        // No benchmark, acordamos a renderização, que espera esta cópia. O
+        // mutex é travado para que o aviso não se perca entre o teste e a
+        // espera da renderização (veja o laço principal em main()).
+        if ( g_BenchmarkFrames > 0 )
+        {
+            {
+                std::lock_guard<std::mutex> lock(g_SimulationMutex);
+            }
+            g_SimulationCondition.notify_all();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::duration<double>(SIMULATION_STEP - accumulator));
+        }
+    }
+}
+
+// Copia o estado atual da simulação para g_Snapshots[g_SnapshotBack] e a
+// troca pela cópia intermediária, que passa a ser a mais recente.
+// Chamada somente pela thread da simulação.
+void PublishSimulationSnapshot(const KartState& previous, double clock, double accumulator, double step_time)
+{
+    SimulationSnapshot& snapshot = g_Snapshots[g_SnapshotBack];
+    snapshot.previous    = previous;
+    snapshot.current     = GetKartState();
+    snapshot.aceleration = g_Car_aceleration;
+    for (int i = 0; i < BOX_AMT; ++i)
+        snapshot.boxes[i] = (coord_vec[i].z == 1);
+    snapshot.points      = main_points;
+    snapshot.time        = g_SimulationTime;
+    snapshot.clock       = clock;
+    snapshot.accumulator = accumulator;
+    snapshot.step_time   = step_time;
+
+    g_SnapshotBack = g_SnapshotMiddle.exchange(g_SnapshotBack | SNAPSHOT_NEW) & SNAPSHOT_INDEX_MASK;
+}
+
+// Retorna a cópia mais recente publicada pela simulação, que não é alterada
+// até a próxima chamada. Chamada somente pela thread de renderização.
+const SimulationSnapshot* AcquireSimulationSnapshot()
+{
+    if ( g_SnapshotMiddle.load() & SNAPSHOT_NEW )
+        g_SnapshotFront = g_SnapshotMiddle.exchange(g_SnapshotFront) & SNAPSHOT_INDEX_MASK;
+
+    return &g_Snapshots[g_SnapshotFront];
+}
+
+// Estado atual do carro, resultado do último passo da simulação
+KartState GetKartState()
+{
+    KartState state;
+    state.position = g_Car_Position;
+    state.front    = g_Car_Front;
+    state.pitch    = g_Car_Pitch;
+    return state;
+}
+
+// Interpola linearmente dois estados do carro, com "alpha" entre 0 (estado
+// "a") e 1 (estado "b"). O ângulo é interpolado pelo menor arco, já que
+// do_car_movement() o volta para zero a cada volta completa.
+KartState InterpolateKartState(const KartState& a, const KartState& b, float alpha)
+{
+    KartState state;
+    state.position = a.position + (b.position - a.position) * alpha;
+
+    state.front = a.front + (b.front - a.front) * alpha;
+    if ( norm(state.front) > 0.0f )
+        state.front = state.front / norm(state.front);
+
+    float delta = b.pitch - a.pitch;
+    delta -= 2.0f*M_PI * floorf(delta / (2.0f*M_PI) + 0.5f);
+    state.pitch = a.pitch + delta * alpha;
+
+    return state;
+}
+
 void check_box_colision() {
 
     for (int i=0; i < BOX_AMT; i++) {
@@ -641,10 +1446,8 @@ void check_box_colision() {
 
         if ( distance < 0.8f) {
 
-            if (coord_vec[i].z == 1) {
+            if (coord_vec[i].z == 1)
                 main_points++;
-                engine->play2D("../../media/box_colision.wav");
-            }
 
             coord_vec[i].z = 0;
         }
@@ -653,8 +1456,8 @@ void check_box_colision() {
 }
 
 int check_wall_colision() {
-    // printf("Min: (%f, %f, %f) \n", g_VirtualScene["mario"].bbox_min.x, g_VirtualScene["mario"].bbox_min.y, g_VirtualScene["mario"].bbox_min.z);
-    // printf("Max: (%f, %f, %f) \n", g_VirtualScene["mario"].bbox_max.x, g_VirtualScene["mario"].bbox_max.y, g_VirtualScene["mario"].bbox_max.z);
+    // printf("Min: (%f, %f, %f) \n", g_VirtualScene[mario_object].bbox_min.x, g_VirtualScene[mario_object].bbox_min.y, g_VirtualScene[mario_object].bbox_min.z);
+    // printf("Max: (%f, %f, %f) \n", g_VirtualScene[mario_object].bbox_max.x, g_VirtualScene[mario_object].bbox_max.y, g_VirtualScene[mario_object].bbox_max.z);
     //printf("Max: (%f, %f, %f) \n", g_Car_Position.x, g_Car_Position.y, g_Car_Position.z);
 
     if ( g_Car_Position.x +0.58 >= 50 )
@@ -671,315 +1474,1182 @@ int check_wall_colision() {
 
 
 
-    return 0;
+    return 0;
+}
+
+// Função que agenda o carregamento de uma imagem para ser utilizada como
+// textura, amostrada com os parâmetros dados em "sampler", e retorna o
+// índice da textura em g_Textures. A imagem é decodificada por uma thread de
+// carregamento (veja "assetloader.h") e enviada para a GPU, junto com as
+// demais imagens de mesmo tamanho, por CreateTextureArrays().
+int LoadTextureImage(const char* filename, const SamplerDesc& sampler)
+{
+    // Cada imagem é carregada uma única vez, mesmo que seja utilizada por
+    // várias texturas
+    int image_index = -1;
+    for (size_t i = 0; i < g_TextureImages.size(); ++i)
+        if ( g_TextureImages[i].filename == filename )
+            image_index = i;
+
+    if ( image_index < 0 )
+    {
+        std::string file = filename;
+        bool use_compressed = g_UseCompressedTextures;
+        std::shared_ptr<DecodedImage> image = std::make_shared<DecodedImage>();
+
+        TextureImage texture_image;
+        texture_image.filename = file;
+        texture_image.image    = image;
+        texture_image.array    = -1;
+        texture_image.layer    = -1;
+
+        image_index = g_TextureImages.size();
+        g_TextureImages.push_back(texture_image);
+
+        AssetLoader_Submit(
+            [=]()
+            {
+                // Se existe uma textura comprimida atualizada, ela é somente
+                // mapeada em memória, sem nenhuma decodificação.
+                if ( use_compressed )
+                {
+                    std::string cooked_filename = TextureFile_CookedFilename(file.c_str());
+                    image->compressed = TextureFile_Open(cooked_filename.c_str(), file.c_str(), image->file);
+
+                    if ( image->compressed && image->file.header->format != TEXTURE_FORMAT_BC1_SRGB )
+                    {
+                        TextureFile_Close(image->file);
+                        image->compressed = false;
+                    }
+
+                    if ( image->compressed )
+                    {
+                        image->width  = image->file.header->width;
+                        image->height = image->file.header->height;
+                        return;
+                    }
+                }
+
+                // Leitura da imagem do disco. A inversão vertical é configurada
+                // uma única vez, antes de iniciar o carregamento (veja main()).
+                image->data = stbi_load(file.c_str(), &image->width, &image->height, &image->channels, 3);
+            },
+            [=]()
+            {
+                if ( !image->compressed && image->data == NULL )
+                {
+                    fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", file.c_str());
+                    std::exit(EXIT_FAILURE);
+                }
+
+                if ( image->compressed )
+                    printf("Carregando imagem \"%s\"... OK (%dx%d, BC1, %d níveis).\n", TextureFile_CookedFilename(file.c_str()).c_str(), image->width, image->height, (int)image->file.header->num_levels);
+                else
+                    printf("Carregando imagem \"%s\"... OK (%dx%d).\n", file.c_str(), image->width, image->height);
+            });
+    }
+
+    Texture texture;
+    texture.image   = image_index;
+    texture.sampler = sampler;
+    texture.unit    = -1;
+
+    g_Textures.push_back(texture);
+    return (int)g_Textures.size() - 1;
+}
+
+// Agrupa as imagens carregadas por LoadTextureImage() em arrays de texturas,
+// um para cada combinação de tamanho e formato, e os envia para a GPU. Em
+// seguida, atribui uma unidade de textura a cada par (array, parâmetros de
+// amostragem) utilizado por alguma textura. Deve ser chamada após o término
+// do carregamento.
+void CreateTextureArrays()
+{
+    for (size_t i = 0; i < g_TextureImages.size(); ++i)
+    {
+        const DecodedImage& image = *g_TextureImages[i].image;
+        int num_levels = image.compressed ? (int)image.file.header->num_levels : 0;
+
+        int array = -1;
+        for (size_t a = 0; a < g_TextureArrays.size(); ++a)
+        {
+            const TextureArray& t = g_TextureArrays[a];
+            if ( t.width == image.width && t.height == image.height && t.compressed == image.compressed && t.num_levels == num_levels )
+                array = a;
+        }
+
+        if ( array < 0 )
+        {
+            TextureArray t;
+            t.texture_id = 0;
+            t.width      = image.width;
+            t.height     = image.height;
+            t.compressed = image.compressed;
+            t.num_levels = num_levels;
+
+            array = g_TextureArrays.size();
+            g_TextureArrays.push_back(t);
+        }
+
+        g_TextureImages[i].array = array;
+        g_TextureImages[i].layer = g_TextureArrays[array].images.size();
+        g_TextureArrays[array].images.push_back(i);
+    }
+
+    // Agora enviamos as imagens lidas do disco para a GPU
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+
+    glActiveTexture(GL_TEXTURE0);
+
+    for (size_t a = 0; a < g_TextureArrays.size(); ++a)
+    {
+        TextureArray& t = g_TextureArrays[a];
+        GLsizei num_layers = t.images.size();
+
+        glGenTextures(1, &t.texture_id);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, t.texture_id);
+
+        if ( t.compressed )
+        {
+            // Todos os níveis de mipmap já estão prontos nos arquivos
+            for (int level = 0; level < t.num_levels; ++level)
+            {
+                const TextureFileLevel& l = g_TextureImages[t.images[0]].image->file.levels[level];
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, l.width, l.height, num_layers, 0, l.size * num_layers, NULL);
+
+                for (GLsizei layer = 0; layer < num_layers; ++layer)
+                {
+                    const TextureFile& file = g_TextureImages[t.images[layer]].image->file;
+                    glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, l.width, l.height, 1, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, file.levels[level].size, file.data + file.levels[level].offset);
+                }
+            }
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, t.num_levels - 1);
+        }
+        else
+        {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_SRGB8, t.width, t.height, num_layers, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+
+            for (GLsizei layer = 0; layer < num_layers; ++layer)
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, t.width, t.height, 1, GL_RGB, GL_UNSIGNED_BYTE, g_TextureImages[t.images[layer]].image->data);
+
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        }
+
+        // As imagens na CPU não são mais necessárias
+        for (GLsizei layer = 0; layer < num_layers; ++layer)
+        {
+            DecodedImage& image = *g_TextureImages[t.images[layer]].image;
+            if ( image.compressed )
+                TextureFile_Close(image.file);
+            else
+                stbi_image_free(image.data);
+            g_TextureImages[t.images[layer]].image.reset();
+        }
+    }
+
+    // Unidades de textura: uma para cada par (array, parâmetros de amostragem)
+    GLint num_units = 0;
+    for (size_t i = 0; i < g_Textures.size(); ++i)
+    {
+        Texture& texture = g_Textures[i];
+        int array = g_TextureImages[texture.image].array;
+
+        for (size_t j = 0; j < i; ++j)
+        {
+            const Texture& other = g_Textures[j];
+            if ( g_TextureImages[other.image].array == array
+              && other.sampler.wrap_mode  == texture.sampler.wrap_mode
+              && other.sampler.min_filter == texture.sampler.min_filter
+              && other.sampler.mag_filter == texture.sampler.mag_filter )
+            {
+                texture.unit = other.unit;
+                break;
+            }
+        }
+
+        if ( texture.unit >= 0 )
+            continue;
+
+        if ( num_units == MAX_TEXTURE_UNITS )
+        {
+            fprintf(stderr, "ERROR: Too many texture units (%d).\n", num_units + 1);
+            std::exit(EXIT_FAILURE);
+        }
+
+        texture.unit = num_units;
+        num_units += 1;
+
+        GLuint sampler_id;
+        glGenSamplers(1, &sampler_id);
+
+        // Veja slide 160 do documento "Aula_20_e_21_Mapeamento_de_Texturas.pdf"
+        glSamplerParameteri(sampler_id, GL_TEXTURE_WRAP_S, texture.sampler.wrap_mode);
+        glSamplerParameteri(sampler_id, GL_TEXTURE_WRAP_T, texture.sampler.wrap_mode);
+
+        // Parâmetros de amostragem da textura. Falaremos sobre eles em uma próxima aula.
+        glSamplerParameteri(sampler_id, GL_TEXTURE_MIN_FILTER, texture.sampler.min_filter);
+        glSamplerParameteri(sampler_id, GL_TEXTURE_MAG_FILTER, texture.sampler.mag_filter);
+
+        glActiveTexture(GL_TEXTURE0 + texture.unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, g_TextureArrays[array].texture_id);
+        glBindSampler(texture.unit, sampler_id);
+    }
+
+    printf("Texturas: %d imagens em %d arrays, %d unidades de textura.\n", (int)g_TextureImages.size(), (int)g_TextureArrays.size(), (int)num_units);
+}
+
+// Verifica se o driver OpenGL suporta uma extensão
+bool IsExtensionSupported(const char* name)
+{
+    GLint num_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+
+    for (GLint i = 0; i < num_extensions; ++i)
+    {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if ( extension != NULL && strcmp(extension, name) == 0 )
+            return true;
+    }
+
+    return false;
+}
+
+// Função que retorna o índice (handle) de um objeto armazenado em
+// g_VirtualScene a partir do seu nome. Deve ser chamada após o carregamento
+// dos modelos, e nunca dentro do laço de renderização.
+int GetVirtualObjectHandle(const char* object_name)
+{
+    std::map<std::string, int>::const_iterator it = g_VirtualSceneHandles.find(object_name);
+
+    if ( it == g_VirtualSceneHandles.end() )
+    {
+        fprintf(stderr, "ERROR: Object \"%s\" not found in the virtual scene.\n", object_name);
+        std::exit(EXIT_FAILURE);
+    }
+
+    return it->second;
+}
+
+// Função que computa os seis planos do frustum a partir da matriz
+// "clip = projection * view" (método de Gribb & Hartmann). Cada plano é
+// armazenado em g_FrustumPlanes como (a,b,c,d), de forma que um ponto p está
+// do lado de dentro se a*px + b*py + c*pz + d >= 0.
+void ExtractFrustumPlanes(const glm::mat4& clip)
+{
+    // Linhas da matriz (GLM armazena as matrizes por colunas)
+    glm::vec4 row0 = glm::vec4(clip[0][0], clip[1][0], clip[2][0], clip[3][0]);
+    glm::vec4 row1 = glm::vec4(clip[0][1], clip[1][1], clip[2][1], clip[3][1]);
+    glm::vec4 row2 = glm::vec4(clip[0][2], clip[1][2], clip[2][2], clip[3][2]);
+    glm::vec4 row3 = glm::vec4(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+
+    g_FrustumPlanes[0] = row3 + row0; // Esquerda
+    g_FrustumPlanes[1] = row3 - row0; // Direita
+    g_FrustumPlanes[2] = row3 + row1; // Baixo
+    g_FrustumPlanes[3] = row3 - row1; // Cima
+    g_FrustumPlanes[4] = row3 + row2; // Near
+    g_FrustumPlanes[5] = row3 - row2; // Far
+}
+
+// Função que testa se a AABB de um objeto (em coordenadas locais), depois de
+// transformada pela matriz "model", intersecta o frustum da câmera. A caixa
+// testada no sistema global é a menor AABB que contém a caixa transformada.
+bool IsBoundingBoxVisible(const glm::vec3& bbox_min, const glm::vec3& bbox_max, const glm::mat4& model)
+{
+    glm::vec3 center = (bbox_min + bbox_max) * 0.5f;
+    glm::vec3 extent = (bbox_max - bbox_min) * 0.5f;
+
+    glm::vec3 world_center = glm::vec3(model * glm::vec4(center, 1.0f));
+    glm::vec3 world_extent = glm::vec3(
+        fabs(model[0][0])*extent.x + fabs(model[1][0])*extent.y + fabs(model[2][0])*extent.z,
+        fabs(model[0][1])*extent.x + fabs(model[1][1])*extent.y + fabs(model[2][1])*extent.z,
+        fabs(model[0][2])*extent.x + fabs(model[1][2])*extent.y + fabs(model[2][2])*extent.z
+    );
+
+    for (int i = 0; i < 6; ++i)
+    {
+        const glm::vec4& plane = g_FrustumPlanes[i];
+
+        // Distância (a menos de escala) do centro da caixa ao plano, e o
+        // "raio" da caixa projetado na normal do plano.
+        float distance = plane.x*world_center.x + plane.y*world_center.y + plane.z*world_center.z + plane.w;
+        float radius   = fabs(plane.x)*world_extent.x + fabs(plane.y)*world_extent.y + fabs(plane.z)*world_extent.z;
+
+        if ( distance + radius < 0.0f )
+            return false;
+    }
+
+    return true;
+}
+
+// Função que escolhe o nível de detalhe de um objeto desenhado com a matriz
+// de modelagem "model", a partir da fração da altura da tela ocupada pela
+// projeção da sua esfera envolvente.
+int SelectLevelOfDetail(const SceneObject& object, const glm::mat4& model)
+{
+    if ( object.num_levels_of_detail == 1 )
+        return 0;
+
+    // Esfera envolvente da AABB, em coordenadas globais. O raio é escalado
+    // pela maior escala presente na matriz de modelagem.
+    glm::vec4 center = model * glm::vec4((object.bbox_min + object.bbox_max) * 0.5f, 1.0f);
+    float scale = std::max(norm(model[0]), std::max(norm(model[1]), norm(model[2])));
+    float radius = 0.5f * glm::length(object.bbox_max - object.bbox_min) * scale;
+
+    float distance = norm(center - g_LodCameraPosition);
+    if ( distance <= radius )
+        return 0;
+
+    // Diâmetro projetado em NDC (2*raio*escala/distância), dividido pela
+    // altura da tela em NDC (2).
+    float screen_fraction = radius * g_LodProjectionScale / distance;
+
+    int lod = 0;
+    while ( lod < object.num_levels_of_detail - 1 && screen_fraction < g_LodScreenFractions[lod] )
+        lod += 1;
+
+    return lod;
+}
+
+// Função que desenha um objeto armazenado em g_VirtualScene, utilizando a
+// matriz de modelagem "model". Objetos fora do frustum da câmera são
+// descartados sem nenhuma chamada à OpenGL.
+void DrawVirtualObject(int object_handle, const glm::mat4& model, GLintptr draw_uniforms_offset)
+{
+    const SceneObject& object = g_VirtualScene[object_handle];
+
+    if ( !IsBoundingBoxVisible(object.bbox_min, object.bbox_max, model) )
+    {
+        g_CulledObjects += 1;
+        return;
+    }
+    g_DrawnObjects += 1;
+
+    int lod = SelectLevelOfDetail(object, model);
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_UNIFORMS_BINDING, g_UniformBufferId, draw_uniforms_offset, sizeof(DrawUniforms));
+
+    glDrawElementsBaseVertex(
+        object.rendering_mode,
+        object.num_indices[lod],
+        GL_UNSIGNED_INT,
+        (void*)object.first_index[lod],
+        object.base_vertex
+    );
+}
+
+// Função que desenha várias cópias (instâncias) de um objeto armazenado em
+// g_VirtualScene com uma única chamada glDrawElementsInstanced(). A matriz
+// "model" de cada instância é lida do vetor "models"; somente as instâncias
+// dentro do frustum da câmera são enviadas para a GPU.
+void DrawVirtualObjectInstanced(int object_handle, const std::vector<glm::mat4>& models, GLintptr draw_uniforms_offset)
+{
+    const SceneObject& object = g_VirtualScene[object_handle];
+
+    // Todas as instâncias são desenhadas com o nível de detalhe da maior
+    // delas na tela (o menor nível entre as instâncias visíveis).
+    int lod = MAX_LEVELS_OF_DETAIL - 1;
+
+    g_VisibleInstances.clear();
+    for (size_t i = 0; i < models.size(); ++i)
+    {
+        if ( IsBoundingBoxVisible(object.bbox_min, object.bbox_max, models[i]) )
+        {
+            g_VisibleInstances.push_back(models[i]);
+            lod = std::min(lod, SelectLevelOfDetail(object, models[i]));
+        }
+    }
+
+    g_DrawnObjects  += g_VisibleInstances.size();
+    g_CulledObjects += models.size() - g_VisibleInstances.size();
+
+    if ( g_VisibleInstances.empty() )
+        return;
+
+    // Enviamos as matrizes para a GPU. Pedimos um novo armazenamento com
+    // glBufferData() ("orphaning") para não esperar por desenhos anteriores
+    // que ainda estejam lendo o buffer.
+    glBindBuffer(GL_ARRAY_BUFFER, g_InstanceBufferId);
+    glBufferData(GL_ARRAY_BUFFER, g_VisibleInstances.size() * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, g_VisibleInstances.size() * sizeof(glm::mat4), g_VisibleInstances.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_UNIFORMS_BINDING, g_UniformBufferId, draw_uniforms_offset, sizeof(DrawUniforms));
+
+    glDrawElementsInstancedBaseVertex(
+        object.rendering_mode,
+        object.num_indices[lod],
+        GL_UNSIGNED_INT,
+        (void*)object.first_index[lod],
+        g_VisibleInstances.size(),
+        object.base_vertex
+    );
+}
+
+// Função que agenda o desenho de um objeto de g_VirtualScene, com o material e
+// a matriz de modelagem dados, para o quadro atual. Veja SubmitDrawCommands().
+void QueueDrawVirtualObject(int material, int object_handle, const glm::mat4& model, bool cull_face)
+{
+    DrawCommand command;
+    command.material      = material;
+    command.object_handle = object_handle;
+    command.model         = model;
+    command.instances     = NULL;
+    command.cull_face     = cull_face;
+    command.static_batch  = false;
+    g_DrawCommands.push_back(command);
+}
+
+// Análoga à função acima, para desenhos instanciados. O vetor "models" deve
+// continuar válido até a chamada de SubmitDrawCommands().
+void QueueDrawVirtualObjectInstanced(int material, int object_handle, const std::vector<glm::mat4>* models)
+{
+    DrawCommand command;
+    command.material      = material;
+    command.object_handle = object_handle;
+    command.instances     = models;
+    command.cull_face     = true;
+    command.static_batch  = false;
+    g_DrawCommands.push_back(command);
+}
+
+// Agenda o desenho de todos os lotes estáticos (veja BuildStaticBatches()).
+// Os vértices já estão em coordenadas globais, então a matriz de modelagem é
+// a identidade.
+void QueueDrawStaticBatches()
+{
+    for (size_t i = 0; i < g_StaticBatches.size(); ++i)
+    {
+        DrawCommand command;
+        command.material      = g_StaticBatches[i].material;
+        command.object_handle = g_StaticBatches[i].object_handle;
+        command.model         = glm::mat4(1.0f);
+        command.instances     = NULL;
+        command.cull_face     = g_StaticBatches[i].cull_face;
+        command.static_batch  = true;
+        g_DrawCommands.push_back(command);
+    }
+}
+
+// Computa a chave de ordenação de um comando de desenho, com os campos, do
+// mais para o menos significativo:
+//
+//   bits 60-63  passo de renderização (g_MaterialRenderPass)
+//   bits 52-59  material, isto é, o programa de GPU (a textura de cada
+//               material é fixa, então também fica agrupada)
+//   bit  48     backface culling desabilitado
+//   bits 16-47  quadrado da distância da câmera ao objeto (bits do float, que
+//               para valores positivos têm a mesma ordem que os números)
+//   bits  0-15  ordem em que o comando foi agendado, para desempate
+//
+// Assim, as trocas de estado da OpenGL ocorrem somente entre grupos, e dentro
+// de cada grupo os objetos mais próximos são desenhados primeiro.
+uint64_t ComputeDrawSortKey(const DrawCommand& command, size_t sequence)
+{
+    const SceneObject& object = g_VirtualScene[command.object_handle];
+    glm::vec4 center = glm::vec4((object.bbox_min + object.bbox_max) * 0.5f, 1.0f);
+
+    // Para desenhos instanciados, usamos a instância mais próxima
+    float distance2 = std::numeric_limits<float>::max();
+    if ( command.instances != NULL )
+    {
+        for (size_t i = 0; i < command.instances->size(); ++i)
+        {
+            glm::vec4 d = (*command.instances)[i] * center - g_LodCameraPosition;
+            distance2 = std::min(distance2, glm::dot(d, d));
+        }
+    }
+    else
+    {
+        glm::vec4 d = command.model * center - g_LodCameraPosition;
+        distance2 = glm::dot(d, d);
+    }
+
+    uint32_t depth;
+    memcpy(&depth, &distance2, sizeof(depth));
+
+    return ((uint64_t)g_MaterialRenderPass[command.material] << 60)
+         | ((uint64_t)command.material << 52)
+         | ((uint64_t)!command.cull_face << 48)
+         | ((uint64_t)depth << 16)
+         | (uint64_t)(sequence & 0xFFFF);
+}
+
+// Critério de ordenação dos comandos de desenho. Veja ComputeDrawSortKey().
+bool CompareDrawCommands(const DrawCommand& a, const DrawCommand& b)
+{
+    return a.sort_key < b.sort_key;
+}
+
+// Função que cria o buffer circular de uniform blocks. Veja g_UniformBufferId.
+void CreateUniformBuffers()
+{
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &g_UniformBufferAlignment);
+
+    glGenBuffers(1, &g_UniformBufferId);
+    glBindBuffer(GL_UNIFORM_BUFFER, g_UniformBufferId);
+    glBufferData(GL_UNIFORM_BUFFER, UNIFORM_RING_FRAMES * UNIFORM_SEGMENT_SIZE, NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    for (int i = 0; i < UNIFORM_RING_FRAMES; ++i)
+        g_UniformRingFences[i] = 0;
+}
+
+// Função que cria as buffer textures das fontes de luz pontuais e as liga
+// às suas unidades de textura. Veja g_LightBufferIds.
+void CreateLightBuffers()
+{
+    const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+    const GLint  units[3]   = { LIGHT_DATA_UNIT, LIGHT_CLUSTERS_UNIT, LIGHT_INDICES_UNIT };
+
+    glGenBuffers(3, g_LightBufferIds);
+    glGenTextures(3, g_LightTextureIds);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, g_LightBufferIds[i]);
+        glBufferData(GL_TEXTURE_BUFFER, g_LightBufferSizes[i], NULL, GL_STREAM_DRAW);
+
+        glActiveTexture(GL_TEXTURE0 + units[i]);
+        glBindTexture(GL_TEXTURE_BUFFER, g_LightTextureIds[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], g_LightBufferIds[i]);
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// Função que lista as fontes de luz pontuais do quadro atual: uma sobre cada
+// caixa ainda não coletada, a chama atrás do carro, cuja intensidade
+// acompanha a aceleração, e as lâmpadas fixas sobre as estacas e ao longo
+// das paredes da pista.
+void GatherPointLights(const KartState& kart, float aceleration)
+{
+    g_PointLights.clear();
+
+    PointLight light;
+
+    for (int i = 0; i < BOX_AMT; ++i)
+    {
+        if ( !g_RenderState->boxes[i] )
+            continue;
+
+        light.position = glm::vec3(coord_vec[i].x, 1.0f, coord_vec[i].y);
+        light.radius   = 4.0f;
+        light.color    = glm::vec3(0.6f, 0.45f, 0.15f);
+        g_PointLights.push_back(light);
+    }
+
+    float flame = std::min(std::max((aceleration - 1.0f) / 7.5f, 0.0f), 1.0f);
+    if ( flame > 0.0f )
+    {
+        light.position = glm::vec3(kart.position - 0.7f * kart.front) + glm::vec3(0.0f, 0.4f, 0.0f);
+        light.radius   = 2.5f;
+        light.color    = flame * glm::vec3(1.2f, 0.5f, 0.1f);
+        g_PointLights.push_back(light);
+    }
+
+    // Lâmpadas sobre as duas estacas da linha de chegada
+    light.radius = 5.0f;
+    light.color  = glm::vec3(0.8f, 0.7f, 0.4f);
+    light.position = glm::vec3(42.0f, 2.2f, -42.0f);
+    g_PointLights.push_back(light);
+    light.position = glm::vec3(48.0f, 2.2f, -42.0f);
+    g_PointLights.push_back(light);
+
+    // Lâmpadas junto às quatro paredes, a cada 20 unidades
+    light.radius = 8.0f;
+    light.color  = glm::vec3(0.35f, 0.4f, 0.6f);
+    for (int i = -2; i <= 2; ++i)
+    {
+        float t = 20.0f * i;
+        light.position = glm::vec3(t, 2.0f, -49.0f); g_PointLights.push_back(light);
+        light.position = glm::vec3(t, 2.0f,  49.0f); g_PointLights.push_back(light);
+        light.position = glm::vec3(-49.0f, 2.0f, t); g_PointLights.push_back(light);
+        light.position = glm::vec3( 49.0f, 2.0f, t); g_PointLights.push_back(light);
+    }
+
+    if ( g_PointLights.size() > MAX_POINT_LIGHTS )
+        g_PointLights.resize(MAX_POINT_LIGHTS);
+}
+
+// Função que constrói as listas de luzes dos clusters para a câmera atual,
+// cujos planos near e far estão às distâncias "near" e "far", e as envia para
+// a GPU. A cena é desenhada em "width" x "height" pixels. Cada buffer é
+// realocado (orphaning) antes de ser preenchido, então a GPU pode continuar
+// lendo os dados do quadro anterior sem sincronização.
+void UpdateLightClusters(const glm::mat4& view, const glm::mat4& projection, float near, float far, int width, int height)
+{
+    LightClusters_Build(g_PointLights, view, projection, near, far, g_LightClusters);
+
+    g_LightData.resize(2 * g_PointLights.size());
+    for (size_t i = 0; i < g_PointLights.size(); ++i)
+    {
+        g_LightData[2*i]   = glm::vec4(g_PointLights[i].position, g_PointLights[i].radius);
+        g_LightData[2*i+1] = glm::vec4(g_PointLights[i].color, 0.0f);
+    }
+
+    const void*      data[3] = { g_LightData.data(), g_LightClusters.offset_count.data(), g_LightClusters.indices.data() };
+    const GLsizeiptr used[3] = { (GLsizeiptr)(g_LightData.size() * sizeof(glm::vec4)),
+                                 (GLsizeiptr)(g_LightClusters.offset_count.size() * sizeof(unsigned int)),
+                                 (GLsizeiptr)(g_LightClusters.indices.size() * sizeof(unsigned int)) };
+
+    for (int i = 0; i < 3; ++i)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, g_LightBufferIds[i]);
+        glBufferData(GL_TEXTURE_BUFFER, g_LightBufferSizes[i], NULL, GL_STREAM_DRAW);
+        if ( used[i] > 0 )
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, used[i], data[i]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    g_ClusterParams = glm::vec4((float)CLUSTER_TILES_X / width,
+                                (float)CLUSTER_TILES_Y / height,
+                                CLUSTER_SLICES / std::log(far / near),
+                                near);
+}
+
+// Função que reserva "size" bytes, alinhados, no segmento do quadro atual,
+// copia "data" para lá e retorna a posição reservada dentro do segmento.
+size_t AppendUniformData(const void* data, size_t size)
+{
+    size_t offset = g_UniformStaging.size();
+    size_t aligned_size = (size + g_UniformBufferAlignment - 1) / g_UniformBufferAlignment * g_UniformBufferAlignment;
+
+    if ( offset + aligned_size > UNIFORM_SEGMENT_SIZE )
+    {
+        fprintf(stderr, "ERROR: Too many draw commands for the uniform buffer segment (%d bytes).\n", UNIFORM_SEGMENT_SIZE);
+        std::exit(EXIT_FAILURE);
+    }
+
+    g_UniformStaging.resize(offset + aligned_size);
+    memcpy(&g_UniformStaging[offset], data, size);
+
+    return offset;
 }
 
-// Função que carrega uma imagem para ser utilizada como textura
-void LoadTextureImage(const char* filename)
+// Função que desenha todos os objetos agendados no quadro atual. Os comandos
+// são ordenados pela sua chave (veja ComputeDrawSortKey()), de forma que cada
+// programa de GPU é ativado uma única vez por quadro e os objetos opacos são
+// desenhados da frente para trás, com o céu por último. Os uniform blocks de
+// todos os desenhos são escritos de uma só vez no segmento do quadro atual do
+// buffer circular g_UniformBufferId.
+void SubmitDrawCommands(const glm::mat4& view, const glm::mat4& projection)
 {
-    printf("Carregando imagem \"%s\"... ", filename);
+    // Os objetos opacos e os de fundo são medidos separadamente pelo profiler
+    int profiler_section = PROFILER_SCENE;
+    Profiler_Begin(profiler_section);
+
+    // Preenchemos o segmento do quadro atual: primeiro os parâmetros comuns a
+    // todo o quadro, e depois os de cada desenho.
+    g_UniformStaging.clear();
+
+    FrameUniforms frame;
+    frame.view            = view;
+    frame.projection      = projection;
+    frame.camera_position = glm::inverse(view) * glm::vec4(0.0f,0.0f,0.0f,1.0f);
+    frame.light_direction = glm::vec4(0.0f,1.0f,0.0f,0.0f);
+    frame.cluster_params  = g_ClusterParams;
+
+    g_LodCameraPosition  = frame.camera_position;
+    g_LodProjectionScale = projection[1][1];
+    size_t frame_uniforms_offset = AppendUniformData(&frame, sizeof(FrameUniforms));
+
+    // Ordenamos os comandos pelo passo, pelo estado da OpenGL e pela
+    // distância à câmera
+    for (size_t i = 0; i < g_DrawCommands.size(); ++i)
+        g_DrawCommands[i].sort_key = ComputeDrawSortKey(g_DrawCommands[i], i);
+    std::sort(g_DrawCommands.begin(), g_DrawCommands.end(), CompareDrawCommands);
+
+    for (size_t i = 0; i < g_DrawCommands.size(); ++i)
+    {
+        DrawCommand& command = g_DrawCommands[i];
+
+        DrawUniforms draw;
+        draw.model         = command.model;
+        draw.normal_matrix = command.static_batch ? command.model : glm::inverse(glm::transpose(command.model));
+        draw.instanced     = command.instances != NULL;
+        draw.bbox_min      = glm::vec4(g_VirtualScene[command.object_handle].bbox_min, 1.0f);
+        draw.bbox_max      = glm::vec4(g_VirtualScene[command.object_handle].bbox_max, 1.0f);
+        draw.padding[0] = draw.padding[1] = draw.padding[2] = 0;
+        command.draw_uniforms_offset = AppendUniformData(&draw, sizeof(DrawUniforms));
+    }
 
-    // Primeiro fazemos a leitura da imagem do disco
-    stbi_set_flip_vertically_on_load(true);
-    int width;
-    int height;
-    int channels;
-    unsigned char *data = stbi_load(filename, &width, &height, &channels, 3);
+    // Esperamos a GPU terminar o quadro que usou este segmento pela última
+    // vez (UNIFORM_RING_FRAMES quadros atrás), e então o sobrescrevemos sem
+    // sincronização adicional da OpenGL. Se a espera falhar, não sabemos se
+    // a GPU ainda lê o segmento, e deixamos a OpenGL sincronizar o mapeamento.
+    GLbitfield map_access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
 
-    if ( data == NULL )
+    GLsync& fence = g_UniformRingFences[g_UniformRingFrame];
+    if ( fence != 0 )
     {
-        fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", filename);
-        std::exit(EXIT_FAILURE);
+        GLenum wait_result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+        while ( wait_result == GL_TIMEOUT_EXPIRED )
+            wait_result = glClientWaitSync(fence, 0, GLuint64(1000000000));
+
+        if ( wait_result == GL_WAIT_FAILED )
+            map_access &= ~GL_MAP_UNSYNCHRONIZED_BIT;
+
+        glDeleteSync(fence);
+        fence = 0;
     }
 
-    printf("OK (%dx%d).\n", width, height);
+    GLintptr segment_offset = g_UniformRingFrame * UNIFORM_SEGMENT_SIZE;
 
-    // Agora criamos objetos na GPU com OpenGL para armazenar a textura
-    GLuint texture_id;
-    GLuint sampler_id;
-    glGenTextures(1, &texture_id);
-    glGenSamplers(1, &sampler_id);
+    glBindBuffer(GL_UNIFORM_BUFFER, g_UniformBufferId);
+    void* segment = glMapBufferRange(GL_UNIFORM_BUFFER, segment_offset, g_UniformStaging.size(), map_access);
+    memcpy(segment, g_UniformStaging.data(), g_UniformStaging.size());
+    glUnmapBuffer(GL_UNIFORM_BUFFER);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-    // Veja slide 160 do documento "Aula_20_e_21_Mapeamento_de_Texturas.pdf"
-    glSamplerParameteri(sampler_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glSamplerParameteri(sampler_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, g_UniformBufferId, segment_offset + frame_uniforms_offset, sizeof(FrameUniforms));
 
-    // Parâmetros de amostragem da textura. Falaremos sobre eles em uma próxima aula.
-    glSamplerParameteri(sampler_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glSamplerParameteri(sampler_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // Todos os objetos compartilham o mesmo VAO, ativado uma única vez
+    glBindVertexArray(g_SceneVertexArrayId);
 
-    // Agora enviamos a imagem lida do disco para a GPU
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
-    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    int  current_material = -1;
+    bool cull_face = true;
+
+    for (size_t i = 0; i < g_DrawCommands.size(); ++i)
+    {
+        const DrawCommand& command = g_DrawCommands[i];
+
+        if ( profiler_section == PROFILER_SCENE && g_MaterialRenderPass[command.material] == RENDER_PASS_BACKGROUND )
+        {
+            Profiler_End(profiler_section);
+            profiler_section = PROFILER_SKY;
+            Profiler_Begin(profiler_section);
+        }
 
-    GLuint textureunit = g_NumLoadedTextures;
-    glActiveTexture(GL_TEXTURE0 + textureunit);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glBindSampler(textureunit, sampler_id);
+        if ( command.material != current_material )
+        {
+            current_material = command.material;
+            g_CurrentProgram = &g_MaterialPrograms[current_material];
 
-    stbi_image_free(data);
+            // Pedimos para a GPU utilizar o programa do material
+            glUseProgram(g_CurrentProgram->program_id);
+        }
 
-    g_NumLoadedTextures += 1;
-}
+        if ( command.cull_face != cull_face )
+        {
+            cull_face = command.cull_face;
+            if ( cull_face )
+                glEnable(GL_CULL_FACE);
+            else
+                glDisable(GL_CULL_FACE);
+        }
 
-// Função que desenha um objeto armazenado em g_VirtualScene.
-void DrawVirtualObject(const char* object_name)
-{
+        if ( command.instances != NULL )
+            DrawVirtualObjectInstanced(command.object_handle, *command.instances, segment_offset + command.draw_uniforms_offset);
+        else
+            DrawVirtualObject(command.object_handle, command.model, segment_offset + command.draw_uniforms_offset);
+    }
 
-    glBindVertexArray(g_VirtualScene[object_name].vertex_array_object_id);
-    glDrawElements(
-        g_VirtualScene[object_name].rendering_mode,
-        g_VirtualScene[object_name].num_indices,
-        GL_UNSIGNED_INT,
-        (void*)g_VirtualScene[object_name].first_index
-    );
+    if ( !cull_face )
+        glEnable(GL_CULL_FACE);
 
     glBindVertexArray(0);
+    glUseProgram(0);
+    g_CurrentProgram = NULL;
+
+    // Marcamos o fim dos desenhos que leem este segmento, e avançamos o buffer circular
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    g_UniformRingFrame = (g_UniformRingFrame + 1) % UNIFORM_RING_FRAMES;
+
+    Profiler_End(profiler_section);
 }
 
-// Função que carrega os shaders de vértices e de fragmentos que serão utilizados para renderização.
+// Função que carrega os shaders de vértices e de fragmentos que serão utilizados
+// para renderização. Para cada material é criado um programa de GPU próprio, a
+// partir do mesmo código fonte, com OBJECT_ID definido pelo pré-processador.
 void LoadShadersFromFiles()
 {
-    vertex_shader_id = LoadShader_Vertex("./src/shader_vertex.glsl");
-    fragment_shader_id = LoadShader_Fragment("./src/shader_fragment.glsl");
+    std::string vertex_source = LoadShaderSource("./src/shader_vertex.glsl");
 
-    if ( program_id != 0 )
-        glDeleteProgram(program_id);
+    for (int material = 0; material < NUM_MATERIALS; ++material)
+    {
+        char defines[256];
+        snprintf(defines, 256, "#define OBJECT_ID %d\n"
+                               "#define CLUSTER_TILES_X %d\n"
+                               "#define CLUSTER_TILES_Y %d\n"
+                               "#define CLUSTER_SLICES %d\n",
+                 material, CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_SLICES);
 
-    program_id = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
+        std::string fragment_source = LoadShaderSource("./src/shader_fragment.glsl", defines);
+
+        GpuProgram& program = g_MaterialPrograms[material];
 
-    model_uniform           = glGetUniformLocation(program_id, "model"); // Variável da matriz "model"
-    view_uniform            = glGetUniformLocation(program_id, "view"); // Variável da matriz "view" em shader_vertex.glsl
-    projection_uniform      = glGetUniformLocation(program_id, "projection"); // Variável da matriz "projection" em shader_vertex.glsl
-    object_id_uniform       = glGetUniformLocation(program_id, "object_id"); // Variável "object_id" em shader_fragment.glsl
+        if ( program.program_id != 0 )
+            glDeleteProgram(program.program_id);
 
-    bbox_min_uniform        = glGetUniformLocation(program_id, "bbox_min");
-    bbox_max_uniform        = glGetUniformLocation(program_id, "bbox_max");
+        GLuint program_id = CreateGpuProgramFromSource(vertex_source, fragment_source, "./src/shader_vertex.glsl", "./src/shader_fragment.glsl");
+        program.program_id = program_id;
+
+        // Uniform blocks "FrameUniforms" e "DrawUniforms" em shader_vertex.glsl e shader_fragment.glsl
+        GLuint frame_block_index = glGetUniformBlockIndex(program_id, "FrameUniforms");
+        if ( frame_block_index != GL_INVALID_INDEX )
+            glUniformBlockBinding(program_id, frame_block_index, FRAME_UNIFORMS_BINDING);
+
+        GLuint draw_block_index = glGetUniformBlockIndex(program_id, "DrawUniforms");
+        if ( draw_block_index != GL_INVALID_INDEX )
+            glUniformBlockBinding(program_id, draw_block_index, DRAW_UNIFORMS_BINDING);
+
+        // Repetição das coordenadas de textura do material
+        glUseProgram(program_id);
+        glUniform2f(glGetUniformLocation(program_id, "uv_scale"), g_MaterialUVScale[material].x, g_MaterialUVScale[material].y);
 
-    // Variáveis em "shader_fragment.glsl" para acesso das imagens de textura
-    glUseProgram(program_id);
-    glUniform1i(glGetUniformLocation(program_id, "TextureImage0"), 0);
-    glUniform1i(glGetUniformLocation(program_id, "TextureImage1"), 1);
-    glUniform1i(glGetUniformLocation(program_id, "TextureImage2"), 2);
-    glUniform1i(glGetUniformLocation(program_id, "TextureImage3"), 3);
-    glUniform1i(glGetUniformLocation(program_id, "TextureImage4"), 4);
-    glUniform1i(glGetUniformLocation(program_id, "TextureImage5"), 5);
-    glUniform1i(glGetUniformLocation(program_id, "TextureImage6"), 6);
+        // Buffer textures das fontes de luz pontuais
+        glUniform1i(glGetUniformLocation(program_id, "light_data"), LIGHT_DATA_UNIT);
+        glUniform1i(glGetUniformLocation(program_id, "light_clusters"), LIGHT_CLUSTERS_UNIT);
+        glUniform1i(glGetUniformLocation(program_id, "light_indices"), LIGHT_INDICES_UNIT);
+    }
 
     glUseProgram(0);
+
+    // Texturas dos materiais (quando os shaders são recarregados durante a
+    // execução; no carregamento inicial, as texturas ainda não existem)
+    UpdateMaterialTextureUniforms();
 }
 
-// Função que computa as normais de um ObjModel, caso elas não tenham sido
-// especificadas dentro do arquivo ".obj"
-void ComputeNormals(ObjModel* model)
+// Informa a cada programa de GPU a unidade de textura e a camada do array
+// da textura do seu material (uniforms "material_texture" e
+// "material_layer" em shader_fragment.glsl). Só tem efeito após
+// CreateTextureArrays().
+void UpdateMaterialTextureUniforms()
 {
-    // if ( !model->attrib.normals.empty() )
-    //     return;
+    for (int material = 0; material < NUM_MATERIALS; ++material)
+    {
+        int texture = g_MaterialTexture[material];
+        if ( texture < 0 || g_Textures[texture].unit < 0 )
+            continue;
 
-    size_t num_vertices = model->attrib.vertices.size() / 3;
+        GLuint program_id = g_MaterialPrograms[material].program_id;
+        glUseProgram(program_id);
+        glUniform1i(glGetUniformLocation(program_id, "material_texture"), g_Textures[texture].unit);
+        glUniform1f(glGetUniformLocation(program_id, "material_layer"), (float)g_TextureImages[g_Textures[texture].image].layer);
+    }
 
-    std::vector<int> num_triangles_per_vertex(num_vertices, 0);
-    std::vector<glm::vec4> vertex_normals(num_vertices, glm::vec4(0.0f,0.0f,0.0f,0.0f));
+    glUseProgram(0);
+}
 
-    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
-    {
-        size_t num_triangles = model->shapes[shape].mesh.num_face_vertices.size();
+// Modelo carregado por uma thread de carregamento, aguardando a adição à
+// cena virtual. Veja LoadModelAndAddToVirtualScene().
+struct LoadedModel
+{
+    bool        cooked; // Se true, a malha está em "file"; senão, em "mesh"
+    MeshFile    file;
+    MeshData    mesh;
+    std::string error;
+};
+
+// Agenda o carregamento de um modelo geométrico e a sua adição à cena
+// virtual. Se existe um arquivo ".mesh" atualizado gerado pelo "cooker" (veja
+// "meshfile.h"), ele é mapeado em memória e os seus vértices e índices são
+// copiados diretamente; caso contrário, o modelo ".obj" é carregado e
+// processado pela thread de carregamento (veja "assetloader.h").
+void LoadModelAndAddToVirtualScene(const char* filename)
+{
+    std::string file = filename;
+    std::shared_ptr<LoadedModel> loaded = std::make_shared<LoadedModel>();
 
-        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
+    AssetLoader_Submit(
+        [=]()
         {
-            assert(model->shapes[shape].mesh.num_face_vertices[triangle] == 3);
+            std::string mesh_filename = MeshFile_CookedFilename(file.c_str());
 
-            glm::vec4  vertices[3];
-            for (size_t vertex = 0; vertex < 3; ++vertex)
+            loaded->cooked = MeshFile_Open(mesh_filename.c_str(), file.c_str(), loaded->file);
+            if ( loaded->cooked )
+                return;
+
+            try
             {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
-                const float vx = model->attrib.vertices[3*idx.vertex_index + 0];
-                const float vy = model->attrib.vertices[3*idx.vertex_index + 1];
-                const float vz = model->attrib.vertices[3*idx.vertex_index + 2];
-                vertices[vertex] = glm::vec4(vx,vy,vz,1.0);
+                ObjModel model(file.c_str());
+                MeshProcessing_ComputeNormals(model.attrib, model.shapes);
+                MeshProcessing_BuildMesh(model.attrib, model.shapes, loaded->mesh);
             }
-
-            const glm::vec4  a = vertices[0];
-            const glm::vec4  b = vertices[1];
-            const glm::vec4  c = vertices[2];
-
-            const glm::vec4  n = crossproduct((b-a),(c-a))/norm(crossproduct((b-a),(c-a)));
-
-            for (size_t vertex = 0; vertex < 3; ++vertex)
+            catch ( const std::exception& e )
             {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
-                num_triangles_per_vertex[idx.vertex_index] += 1;
-                vertex_normals[idx.vertex_index] += n;
-                model->shapes[shape].mesh.indices[3*triangle + vertex].normal_index = idx.vertex_index;
+                loaded->error = e.what();
+            }
+        },
+        [=]()
+        {
+            if ( !loaded->error.empty() )
+            {
+                fprintf(stderr, "ERROR: Cannot load model \"%s\": %s\n", file.c_str(), loaded->error.c_str());
+                std::exit(EXIT_FAILURE);
             }
-        }
-    }
 
-    model->attrib.normals.resize( 3*num_vertices );
+            if ( loaded->cooked )
+            {
+                const MeshFile& f = loaded->file;
+                printf("Carregando malha \"%s\"... OK.\n", MeshFile_CookedFilename(file.c_str()).c_str());
+                AddMeshToVirtualScene(f.shapes, f.header->num_shapes, f.vertices, f.header->num_vertices, f.indices, f.header->num_indices);
+                MeshFile_Close(loaded->file);
+            }
+            else
+            {
+                const MeshData& m = loaded->mesh;
+                AddMeshToVirtualScene(m.shapes.data(), m.shapes.size(), m.vertices.data(), m.vertices.size(), m.indices.data(), m.indices.size());
+                loaded->mesh = MeshData();
+            }
+        });
+}
 
-    for (size_t i = 0; i < vertex_normals.size(); ++i)
+// Adiciona os objetos de uma malha processada à cena virtual. Os vértices e
+// índices são adicionados aos vetores compartilhados g_Scene*, que são
+// enviados para a GPU por UploadVirtualSceneToGpu().
+void AddMeshToVirtualScene(const MeshShape* shapes, size_t num_shapes, const SceneVertex* vertices, size_t num_vertices, const unsigned int* indices, size_t num_indices)
+{
+    // Os vértices deste modelo são adicionados ao final dos vetores
+    // compartilhados. Os índices de cada objeto são relativos ao primeiro
+    // vértice do modelo (base_vertex), e o primeiro índice de cada objeto é
+    // deslocado pelos índices dos modelos anteriores.
+    GLint  base_vertex = g_SceneVertices.size();
+    size_t model_first_index = g_SceneIndices.size();
+
+    for (size_t shape = 0; shape < num_shapes; ++shape)
     {
-        glm::vec4 n = vertex_normals[i] / (float)num_triangles_per_vertex[i];
-        n /= norm(n);
-        model->attrib.normals[3*i + 0] = n.x;
-        model->attrib.normals[3*i + 1] = n.y;
-        model->attrib.normals[3*i + 2] = n.z;
+        SceneObject theobject;
+        theobject.name           = shapes[shape].name;
+        theobject.num_levels_of_detail = shapes[shape].num_levels_of_detail;
+        for (int lod = 0; lod < MAX_LEVELS_OF_DETAIL; ++lod)
+        {
+            theobject.first_index[lod] = (void*)((model_first_index + shapes[shape].first_index[lod]) * sizeof(GLuint)); // Primeiro índice
+            theobject.num_indices[lod] = shapes[shape].num_indices[lod]; // Número de indices
+        }
+        theobject.base_vertex    = base_vertex;
+        theobject.rendering_mode = GL_TRIANGLES;       // Índices correspondem ao tipo de rasterização GL_TRIANGLES.
+        theobject.bbox_min       = glm::vec3(shapes[shape].bbox_min[0], shapes[shape].bbox_min[1], shapes[shape].bbox_min[2]);
+        theobject.bbox_max       = glm::vec3(shapes[shape].bbox_max[0], shapes[shape].bbox_max[1], shapes[shape].bbox_max[2]);
+
+        // Um objeto com nome repetido substitui o anterior, mantendo o seu índice.
+        std::map<std::string, int>::iterator it = g_VirtualSceneHandles.find(theobject.name);
+        if ( it != g_VirtualSceneHandles.end() )
+        {
+            g_VirtualScene[it->second] = theobject;
+        }
+        else
+        {
+            g_VirtualSceneHandles[theobject.name] = (int)g_VirtualScene.size();
+            g_VirtualScene.push_back(theobject);
+        }
     }
+
+    g_SceneIndices.insert(g_SceneIndices.end(), indices, indices + num_indices);
+    g_SceneVertices.insert(g_SceneVertices.end(), vertices, vertices + num_vertices);
 }
 
-// Constrói triângulos para futura renderização a partir de um ObjModel.
-void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
+// Adiciona um objeto imóvel, desenhado com o material e a matriz de
+// modelagem dados, a um lote estático. Deve ser chamada depois do carregamento
+// dos modelos e antes de BuildStaticBatches().
+void AddToStaticBatch(int material, int object_handle, const glm::mat4& model, bool cull_face)
 {
-    GLuint vertex_array_object_id;
-    glGenVertexArrays(1, &vertex_array_object_id);
-    glBindVertexArray(vertex_array_object_id);
+    StaticBatchPart part;
+    part.material      = material;
+    part.object_handle = object_handle;
+    part.model         = model;
+    part.cull_face     = cull_face;
+    g_StaticBatchParts.push_back(part);
+}
 
-    std::vector<GLuint> indices;
-    std::vector<float>  model_coefficients;
-    std::vector<float>  normal_coefficients;
-    std::vector<float>  texture_coefficients;
+// Une os objetos adicionados por AddToStaticBatch() com o mesmo material e o
+// mesmo modo de backface culling em um único objeto de g_VirtualScene. Os
+// vértices de cada objeto são transformados para coordenadas globais e
+// adicionados ao final de g_SceneVertices; os índices de cada nível de
+// detalhe são concatenados, na ordem em que os objetos foram adicionados.
+// Deve ser chamada antes de UploadVirtualSceneToGpu().
+void BuildStaticBatches()
+{
+    std::vector<bool> merged(g_StaticBatchParts.size(), false);
 
-    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
+    for (size_t first = 0; first < g_StaticBatchParts.size(); ++first)
     {
-        size_t first_index = indices.size();
-        size_t num_triangles = model->shapes[shape].mesh.num_face_vertices.size();
+        if ( merged[first] )
+            continue;
 
-        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
+        const int  material  = g_StaticBatchParts[first].material;
+        const bool cull_face = g_StaticBatchParts[first].cull_face;
+
+        const float maxval = std::numeric_limits<float>::max();
+        glm::vec3 bbox_min = glm::vec3(maxval,maxval,maxval);
+        glm::vec3 bbox_max = glm::vec3(-maxval,-maxval,-maxval);
+
+        GLint base_vertex = g_SceneVertices.size();
+        int   num_levels_of_detail = 1;
+        std::vector<GLuint> lod_indices[MAX_LEVELS_OF_DETAIL];
+
+        for (size_t i = first; i < g_StaticBatchParts.size(); ++i)
         {
-            assert(model->shapes[shape].mesh.num_face_vertices[triangle] == 3);
+            const StaticBatchPart& part = g_StaticBatchParts[i];
+            if ( merged[i] || part.material != material || part.cull_face != cull_face )
+                continue;
+            merged[i] = true;
 
-            for (size_t vertex = 0; vertex < 3; ++vertex)
-            {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
+            const SceneObject& object = g_VirtualScene[part.object_handle];
+            num_levels_of_detail = std::max(num_levels_of_detail, object.num_levels_of_detail);
 
-                indices.push_back(first_index + 3*triangle + vertex);
+            glm::mat3 normal_matrix = glm::mat3(glm::inverse(glm::transpose(part.model)));
 
-                const float vx = model->attrib.vertices[3*idx.vertex_index + 0];
-                const float vy = model->attrib.vertices[3*idx.vertex_index + 1];
-                const float vz = model->attrib.vertices[3*idx.vertex_index + 2];
-                //printf("tri %d vert %d = (%.2f, %.2f, %.2f)\n", (int)triangle, (int)vertex, vx, vy, vz);
-                model_coefficients.push_back( vx ); // X
-                model_coefficients.push_back( vy ); // Y
-                model_coefficients.push_back( vz ); // Z
-                model_coefficients.push_back( 1.0f ); // W
+            // Cada vértice do objeto é copiado uma única vez, mesmo que seja
+            // referenciado por vários níveis de detalhe.
+            std::map<GLuint, GLuint> copied;
 
-                if ( model->attrib.normals.size() >= (size_t)3*idx.normal_index )
-                {
-                    const float nx = model->attrib.normals[3*idx.normal_index + 0];
-                    const float ny = model->attrib.normals[3*idx.normal_index + 1];
-                    const float nz = model->attrib.normals[3*idx.normal_index + 2];
-                    normal_coefficients.push_back( nx ); // X
-                    normal_coefficients.push_back( ny ); // Y
-                    normal_coefficients.push_back( nz ); // Z
-                    normal_coefficients.push_back( 0.0f ); // W
-                }
+            for (int lod = 0; lod < MAX_LEVELS_OF_DETAIL; ++lod)
+            {
+                const GLuint* indices = &g_SceneIndices[(size_t)object.first_index[lod] / sizeof(GLuint)];
 
-                if ( model->attrib.texcoords.size() >= (size_t)3*idx.texcoord_index )
+                for (int k = 0; k < object.num_indices[lod]; ++k)
                 {
-                    const float u = model->attrib.texcoords[2*idx.texcoord_index + 0];
-                    const float v = model->attrib.texcoords[2*idx.texcoord_index + 1];
-                    texture_coefficients.push_back( u );
-                    texture_coefficients.push_back( v );
+                    std::map<GLuint, GLuint>::iterator it = copied.find(indices[k]);
+                    if ( it == copied.end() )
+                    {
+                        SceneVertex v = g_SceneVertices[object.base_vertex + indices[k]];
+
+                        glm::vec4 p = part.model * glm::vec4(v.position[0], v.position[1], v.position[2], 1.0f);
+                        v.position[0] = p.x;
+                        v.position[1] = p.y;
+                        v.position[2] = p.z;
+                        bbox_min = glm::min(bbox_min, glm::vec3(p));
+                        bbox_max = glm::max(bbox_max, glm::vec3(p));
+
+                        glm::vec3 n;
+                        MeshProcessing_UnpackNormal(v.normal, &n[0]);
+                        n = normal_matrix * n;
+                        if ( glm::length(n) > 0.0f )
+                            n = glm::normalize(n);
+                        v.normal = MeshProcessing_PackNormal(&n[0]);
+
+                        it = copied.insert(std::make_pair(indices[k], (GLuint)(g_SceneVertices.size() - base_vertex))).first;
+                        g_SceneVertices.push_back(v);
+                    }
+                    lod_indices[lod].push_back(it->second);
                 }
             }
         }
 
-        size_t last_index = indices.size() - 1;
-
-        SceneObject theobject;
-        theobject.name           = model->shapes[shape].name;
-        theobject.first_index    = (void*)first_index; // Primeiro índice
-        theobject.num_indices    = last_index - first_index + 1; // Número de indices
-        theobject.rendering_mode = GL_TRIANGLES;       // Índices correspondem ao tipo de rasterização GL_TRIANGLES.
-        theobject.vertex_array_object_id = vertex_array_object_id;
+        char name[64];
+        snprintf(name, 64, "static_batch_%d_%d", material, (int)cull_face);
 
-        g_VirtualScene[model->shapes[shape].name] = theobject;
+        SceneObject batch;
+        batch.name                 = name;
+        batch.num_levels_of_detail = num_levels_of_detail;
+        for (int lod = 0; lod < MAX_LEVELS_OF_DETAIL; ++lod)
+        {
+            batch.first_index[lod] = (void*)(g_SceneIndices.size() * sizeof(GLuint));
+            batch.num_indices[lod] = lod_indices[lod].size();
+            g_SceneIndices.insert(g_SceneIndices.end(), lod_indices[lod].begin(), lod_indices[lod].end());
+        }
+        batch.base_vertex    = base_vertex;
+        batch.rendering_mode = GL_TRIANGLES;
+        batch.bbox_min       = bbox_min;
+        batch.bbox_max       = bbox_max;
+
+        StaticBatch static_batch;
+        static_batch.material      = material;
+        static_batch.object_handle = (int)g_VirtualScene.size();
+        static_batch.cull_face     = cull_face;
+        g_StaticBatches.push_back(static_batch);
+
+        g_VirtualSceneHandles[batch.name] = (int)g_VirtualScene.size();
+        g_VirtualScene.push_back(batch);
     }
 
-    GLuint VBO_model_coefficients_id;
-    glGenBuffers(1, &VBO_model_coefficients_id);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_model_coefficients_id);
-    glBufferData(GL_ARRAY_BUFFER, model_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, model_coefficients.size() * sizeof(float), model_coefficients.data());
+    printf("Lotes estáticos: %d objetos em %d desenhos.\n", (int)g_StaticBatchParts.size(), (int)g_StaticBatches.size());
+
+    g_StaticBatchParts.clear();
+}
+
+// Envia para a GPU os vértices e índices acumulados em g_Scene* por
+// AddMeshToVirtualScene(). Todos os vértices ficam em um único
+// VBO, com os atributos intercalados (veja SceneVertex), e todos os índices em
+// um único IBO.
+void UploadVirtualSceneToGpu()
+{
+    glGenVertexArrays(1, &g_SceneVertexArrayId);
+    glBindVertexArray(g_SceneVertexArrayId);
+
+    GLuint VBO_id;
+    glGenBuffers(1, &VBO_id);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_id);
+    glBufferData(GL_ARRAY_BUFFER, g_SceneVertices.size() * sizeof(SceneVertex), NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, g_SceneVertices.size() * sizeof(SceneVertex), g_SceneVertices.data());
+
     GLuint location = 0; // "(location = 0)" em "shader_vertex.glsl"
-    GLint  number_of_dimensions = 4; // vec4 em "shader_vertex.glsl"
-    glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
+    GLint  number_of_dimensions = 3; // vec3 em "shader_vertex.glsl"
+    glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, sizeof(SceneVertex), (void*)offsetof(SceneVertex, position));
     glEnableVertexAttribArray(location);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    if ( !normal_coefficients.empty() )
-    {
-        GLuint VBO_normal_coefficients_id;
-        glGenBuffers(1, &VBO_normal_coefficients_id);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_normal_coefficients_id);
-        glBufferData(GL_ARRAY_BUFFER, normal_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, normal_coefficients.size() * sizeof(float), normal_coefficients.data());
-        location = 1; // "(location = 1)" em "shader_vertex.glsl"
-        number_of_dimensions = 4; // vec4 em "shader_vertex.glsl"
-        glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(location);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-    }
+    location = 1; // "(location = 1)" em "shader_vertex.glsl"
+    number_of_dimensions = 4; // GL_INT_2_10_10_10_REV exige 4 componentes; o shader lê somente (x,y,z)
+    glVertexAttribPointer(location, number_of_dimensions, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(SceneVertex), (void*)offsetof(SceneVertex, normal));
+    glEnableVertexAttribArray(location);
+
+    location = 2; // "(location = 2)" em "shader_vertex.glsl"
+    number_of_dimensions = 2; // vec2 em "shader_vertex.glsl"
+    glVertexAttribPointer(location, number_of_dimensions, GL_HALF_FLOAT, GL_FALSE, sizeof(SceneVertex), (void*)offsetof(SceneVertex, texcoord));
+    glEnableVertexAttribArray(location);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    if ( !texture_coefficients.empty() )
+    // Matrizes "model" por instância (locations 3 a 6 em "shader_vertex.glsl").
+    // Um mat4 ocupa quatro atributos vec4 consecutivos, um por coluna, que
+    // avançam uma vez por instância (divisor 1) e não por vértice. Deixamos
+    // uma matriz identidade no buffer para que os desenhos não instanciados
+    // tenham sempre algo válido para ler.
+    glm::mat4 identity = Matrix_Identity();
+    glGenBuffers(1, &g_InstanceBufferId);
+    glBindBuffer(GL_ARRAY_BUFFER, g_InstanceBufferId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4), glm::value_ptr(identity), GL_STREAM_DRAW);
+    for (GLuint column = 0; column < 4; ++column)
     {
-        GLuint VBO_texture_coefficients_id;
-        glGenBuffers(1, &VBO_texture_coefficients_id);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_texture_coefficients_id);
-        glBufferData(GL_ARRAY_BUFFER, texture_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, texture_coefficients.size() * sizeof(float), texture_coefficients.data());
-        location = 2; // "(location = 1)" em "shader_vertex.glsl"
-        number_of_dimensions = 2; // vec2 em "shader_vertex.glsl"
-        glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
+        location = 3 + column;
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
         glEnableVertexAttribArray(location);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     GLuint indices_id;
     glGenBuffers(1, &indices_id);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_id);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), NULL, GL_STATIC_DRAW);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indices.size() * sizeof(GLuint), indices.data());
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, g_SceneIndices.size() * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, g_SceneIndices.size() * sizeof(GLuint), g_SceneIndices.data());
     // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); // XXX Errado!
 
     glBindVertexArray(0);
 }
 
-// Carrega um Vertex Shader de um arquivo. Veja definição de LoadShader() abaixo.
-GLuint LoadShader_Vertex(const char* filename)
+// Cria um programa de GPU a partir dos códigos fonte do Vertex Shader e do
+// Fragment Shader. Se o programa já foi compilado em uma execução anterior, o
+// seu binário é lido do cache (veja "programcache.h"), e os shaders não são
+// compilados. Os nomes "vertex_name" e "fragment_name" identificam os shaders
+// nas mensagens de erro.
+GLuint CreateGpuProgramFromSource(const std::string& vertex_source, const std::string& fragment_source, const char* vertex_name, const char* fragment_name)
 {
-    // Criamos um identificador (ID) para este shader, informando que o mesmo
-    // será aplicado nos vértices.
-    GLuint vertex_shader_id = glCreateShader(GL_VERTEX_SHADER);
+    uint64_t key = ProgramCache_Key(vertex_source, fragment_source);
 
-    // Carregamos e compilamos o shader
-    LoadShader(filename, vertex_shader_id);
+    GLuint program_id = ProgramCache_Load(key);
+    if ( program_id != 0 )
+        return program_id;
 
-    // Retorna o ID gerado acima
-    return vertex_shader_id;
-}
+    GLuint vertex_shader_id = glCreateShader(GL_VERTEX_SHADER);
+    CompileShader(vertex_shader_id, vertex_source, vertex_name);
 
-// Carrega um Fragment Shader de um arquivo. Veja definição de LoadShader() abaixo.
-GLuint LoadShader_Fragment(const char* filename)
-{
-    // Criamos um identificador (ID) para este shader, informando que o mesmo
-    // será aplicado nos fragmentos.
     GLuint fragment_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
+    CompileShader(fragment_shader_id, fragment_source, fragment_name);
 
-    // Carregamos e compilamos o shader
-    LoadShader(filename, fragment_shader_id);
+    program_id = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
+    ProgramCache_Store(key, program_id);
 
-    // Retorna o ID gerado acima
-    return fragment_shader_id;
+    return program_id;
 }
 
-// Função auxilar, utilizada pelas duas funções acima. Carrega código de GPU de
-// um arquivo e faz sua compilação.
-void LoadShader(const char* filename, GLuint shader_id)
+// Carrega o código de GPU de um arquivo. As linhas em "defines" (por exemplo,
+// "#define OBJECT_ID 2\n") são inseridas logo após a diretiva "#version".
+std::string LoadShaderSource(const char* filename, const char* defines)
 {
     // Lemos o arquivo de texto indicado pela variável "filename"
     // e colocamos seu conteúdo em memória, apontado pela variável
@@ -995,8 +2665,25 @@ void LoadShader(const char* filename, GLuint shader_id)
     std::stringstream shader;
     shader << file.rdbuf();
     std::string str = shader.str();
-    const GLchar* shader_string = str.c_str();
-    const GLint   shader_string_length = static_cast<GLint>( str.length() );
+
+    // A diretiva "#version" deve ser obrigatoriamente a primeira linha do
+    // shader; por isso as definições são inseridas após ela. A diretiva
+    // "#line" mantém a numeração das linhas nas mensagens de erro.
+    if ( defines[0] != '\0' )
+    {
+        size_t after_version = str.find('\n') + 1;
+        str.insert(after_version, std::string(defines) + "#line 2\n");
+    }
+
+    return str;
+}
+
+// Compila o código "source" de um shader. "name" identifica o shader nas
+// mensagens de erro.
+void CompileShader(GLuint shader_id, const std::string& source, const char* name)
+{
+    const GLchar* shader_string = source.c_str();
+    const GLint   shader_string_length = static_cast<GLint>( source.length() );
 
     // Define o código do shader, contido na string "shader_string"
     glShaderSource(shader_id, 1, &shader_string, &shader_string_length);
@@ -1024,7 +2711,7 @@ void LoadShader(const char* filename, GLuint shader_id)
         if ( !compiled_ok )
         {
             output += "ERROR: OpenGL compilation of \"";
-            output += filename;
+            output += name;
             output += "\" failed.\n";
             output += "== Start of compilation log\n";
             output += log;
@@ -1033,7 +2720,7 @@ void LoadShader(const char* filename, GLuint shader_id)
         else
         {
             output += "WARNING: OpenGL compilation of \"";
-            output += filename;
+            output += name;
             output += "\".\n";
             output += "== Start of compilation log\n";
             output += log;
@@ -1058,6 +2745,9 @@ GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id)
     glAttachShader(program_id, vertex_shader_id);
     glAttachShader(program_id, fragment_shader_id);
 
+    // O binário do programa é guardado no cache após a linkagem
+    ProgramCache_PrepareProgram(program_id);
+
     // Linkagem dos shaders acima ao programa
     glLinkProgram(program_id);
 
@@ -1102,9 +2792,101 @@ GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id)
 // onde são armazenados os pixels da imagem).
 void FramebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
+    // No benchmark, os quadros são exibidos no framebuffer fora da tela, cujo
+    // tamanho não muda com a janela
+    if ( g_OffscreenFramebufferId != 0 )
+        return;
 
     glViewport(0, 0, width, height);
     g_ScreenRatio = (float)width / height;
+
+    g_FramebufferWidth = width;
+    g_FramebufferHeight = height;
+    ResizeSceneFramebuffer(width, height);
+}
+
+// Cria (na primeira chamada) o framebuffer onde a cena é desenhada com
+// resolução reduzida, com cor e profundidade do tamanho do framebuffer de
+// exibição, que é o tamanho da cena com a escala 1. Veja g_ResolutionScale.
+void ResizeSceneFramebuffer(int width, int height)
+{
+    // A janela minimizada tem tamanho zero
+    if ( width <= 0 || height <= 0 )
+        return;
+
+    if ( g_SceneFramebufferId == 0 )
+    {
+        glGenRenderbuffers(1, &g_SceneColorBufferId);
+        glGenRenderbuffers(1, &g_SceneDepthBufferId);
+        glGenFramebuffers(1, &g_SceneFramebufferId);
+    }
+
+    glBindRenderbuffer(GL_RENDERBUFFER, g_SceneColorBufferId);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, g_SceneDepthBufferId);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, g_SceneFramebufferId);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, g_SceneColorBufferId);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, g_SceneDepthBufferId);
+
+    if ( glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE )
+    {
+        fprintf(stderr, "ERROR: Scene framebuffer is incomplete.\n");
+        std::exit(EXIT_FAILURE);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, g_OffscreenFramebufferId);
+}
+
+// Ajusta g_ResolutionScale conforme o tempo de GPU dos quadros medido pelo
+// profiler. Como a maior parte do custo está nos fragmentos, o tempo varia
+// aproximadamente com o quadrado da escala. As medidas são lidas alguns
+// quadros depois e variam bastante de um quadro para o outro, então a escala
+// só é ajustada após DYNAMIC_RESOLUTION_SAMPLES quadros desenhados com a
+// escala atual, pela média dos seus tempos: de uma vez quando a média passa
+// do alvo, e aos poucos quando sobra tempo. Entre 85% e 100% do alvo a escala
+// não muda, para não oscilar.
+void UpdateResolutionScale()
+{
+    static float gpu_time_sum = 0.0f;
+    static int   gpu_time_count = 0;
+    static int   last_frame = -1;
+
+    if ( !g_DynamicResolution )
+    {
+        g_ResolutionScale = 1.0f;
+        return;
+    }
+
+    float gpu_time;
+    int frame = Profiler_GetLastGpuFrameTime(&gpu_time);
+    if ( frame < g_ResolutionScaleFrame || frame == last_frame )
+        return;
+
+    last_frame = frame;
+    gpu_time_sum += gpu_time;
+    gpu_time_count += 1;
+    if ( gpu_time_count < DYNAMIC_RESOLUTION_SAMPLES )
+        return;
+
+    float average = std::max(gpu_time_sum / gpu_time_count, 0.01f);
+    gpu_time_sum = 0.0f;
+    gpu_time_count = 0;
+
+    if ( average >= 0.85f*DYNAMIC_RESOLUTION_TARGET_MS && average <= DYNAMIC_RESOLUTION_TARGET_MS )
+        return;
+
+    float ideal = g_ResolutionScale * sqrtf(DYNAMIC_RESOLUTION_TARGET_MS / average);
+    float scale = (ideal < g_ResolutionScale) ? ideal : g_ResolutionScale + 0.5f*(ideal - g_ResolutionScale);
+    scale = std::min(std::max(scale, DYNAMIC_RESOLUTION_MIN_SCALE), 1.0f);
+
+    if ( scale != g_ResolutionScale )
+    {
+        g_ResolutionScale = scale;
+        g_ResolutionScaleFrame = Profiler_GetFrame();
+    }
 }
 
 // Variáveis globais que armazenam a última posição do cursor do mouse
@@ -1226,6 +3008,7 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mod)
     if (key == GLFW_KEY_R && action == GLFW_PRESS)
     {
         LoadShadersFromFiles();
+        ProgramCache_Save();
         fprintf(stdout,"Shaders recarregados!\n");
         fflush(stdout);
     }
@@ -1235,6 +3018,24 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mod)
         camera_type = !camera_type;
     }
 
+    // Se o usuário apertar a tecla F, mostramos/escondemos os contadores do frustum culling.
+    if (key == GLFW_KEY_F && action == GLFW_PRESS)
+    {
+        g_ShowCullingStats = !g_ShowCullingStats;
+    }
+
+    // Se o usuário apertar a tecla T, mostramos/escondemos os tempos medidos pelo profiler.
+    if (key == GLFW_KEY_T && action == GLFW_PRESS)
+    {
+        g_ShowProfiler = !g_ShowProfiler;
+    }
+
+    // Se o usuário apertar a tecla G, ligamos/desligamos a resolução dinâmica.
+    if (key == GLFW_KEY_G && action == GLFW_PRESS && g_BenchmarkFrames == 0)
+    {
+        g_DynamicResolution = !g_DynamicResolution;
+    }
+
     if(action == GLFW_PRESS)
     {
         if (key == GLFW_KEY_W) key_w_pressed = true;
@@ -1255,6 +3056,138 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mod)
 
 }
 
+// Tempo da partida, em segundos, desde o fim do carregamento. No modo de
+// benchmark o tempo é simulado: avança 1/60 s por quadro, a partir de
+// BENCHMARK_START_TIME.
+double GetGameTime()
+{
+    if ( g_BenchmarkFrames > 0 )
+        return BENCHMARK_START_TIME + g_BenchmarkFrame / 60.0;
+
+    return glfwGetTime();
+}
+
+// Cria o framebuffer fora da tela utilizado no modo de benchmark, com cor e
+// profundidade, e o deixa ativo para todos os desenhos seguintes.
+void CreateOffscreenFramebuffer(int width, int height)
+{
+    GLuint color_id;
+    glGenRenderbuffers(1, &color_id);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_id);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    GLuint depth_id;
+    glGenRenderbuffers(1, &depth_id);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_id);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &g_OffscreenFramebufferId);
+    glBindFramebuffer(GL_FRAMEBUFFER, g_OffscreenFramebufferId);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_id);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_id);
+
+    if ( glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE )
+    {
+        fprintf(stderr, "ERROR: Offscreen framebuffer is incomplete.\n");
+        std::exit(EXIT_FAILURE);
+    }
+
+    glViewport(0, 0, width, height);
+    g_ScreenRatio = (float)width / height;
+
+    g_FramebufferWidth = width;
+    g_FramebufferHeight = height;
+    ResizeSceneFramebuffer(width, height);
+}
+
+// Percurso roteirizado do benchmark: o kart acelera o tempo todo e alterna
+// trechos retos com curvas para a esquerda e para a direita, e a câmera
+// alterna entre a terceira e a primeira pessoa.
+void UpdateBenchmarkInput()
+{
+    int phase = (g_BenchmarkFrame / 120) % 4;
+
+    key_w_pressed = true;
+    key_a_pressed = (phase == 1);
+    key_d_pressed = (phase == 3);
+    key_s_pressed = false;
+    space_pressed = false;
+
+    camera_type = (g_BenchmarkFrame / 300) % 2 == 0;
+}
+
+// Converte um texto em uma string JSON, entre aspas, com os caracteres
+// especiais escapados. Os textos do driver podem conter aspas ou barras.
+std::string JsonString(const char* text)
+{
+    std::string result = "\"";
+    for (const char* c = text; *c != '\0'; ++c)
+    {
+        if ( *c == '"' || *c == '\\' )
+        {
+            result += '\\';
+            result += *c;
+        }
+        else if ( (unsigned char)*c < 0x20 )
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)*c);
+            result += escaped;
+        }
+        else
+        {
+            result += *c;
+        }
+    }
+    return result + "\"";
+}
+
+// Grava em JSON as estatísticas do benchmark: o tempo de todos os quadros e,
+// para cada seção do profiler, os tempos dos últimos PROFILER_HISTORY quadros.
+void WriteBenchmarkReport(const char* filename, const std::vector<float>& frame_times, double load_time)
+{
+    FILE* file = fopen(filename, "w");
+    if ( file == NULL )
+    {
+        fprintf(stderr, "ERROR: Cannot open file \"%s\".\n", filename);
+        std::exit(EXIT_FAILURE);
+    }
+
+    ProfilerStats frame;
+    Profiler_ComputeStats(frame_times.data(), (int)frame_times.size(), &frame);
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"renderer\": %s,\n", JsonString((const char*)glGetString(GL_RENDERER)).c_str());
+    fprintf(file, "  \"version\": %s,\n", JsonString((const char*)glGetString(GL_VERSION)).c_str());
+    fprintf(file, "  \"width\": %d,\n", g_FramebufferWidth);
+    fprintf(file, "  \"height\": %d,\n", g_FramebufferHeight);
+    fprintf(file, "  \"load_time_s\": %.3f,\n", load_time);
+    fprintf(file, "  \"frames\": %d,\n", frame.count);
+    fprintf(file, "  \"frame_time_ms\": { \"min\": %.3f, \"avg\": %.3f, \"p99\": %.3f, \"max\": %.3f },\n",
+            frame.min, frame.avg, frame.p99, frame.max);
+    fprintf(file, "  \"section_frames\": %d,\n", std::min((int)frame_times.size(), PROFILER_HISTORY));
+    fprintf(file, "  \"sections\": {\n");
+    for (int section = 0; section < PROFILER_NUM_SECTIONS; ++section)
+    {
+        ProfilerStats cpu;
+        ProfilerStats gpu;
+        Profiler_GetSectionStats(section, &cpu, &gpu);
+
+        fprintf(file, "    \"%s\": { \"cpu_avg_ms\": %.3f, \"cpu_p99_ms\": %.3f", Profiler_SectionName(section), cpu.avg, cpu.p99);
+        if ( gpu.count > 0 )
+            fprintf(file, ", \"gpu_avg_ms\": %.3f, \"gpu_p99_ms\": %.3f", gpu.avg, gpu.p99);
+        fprintf(file, " }%s\n", section + 1 < PROFILER_NUM_SECTIONS ? "," : "");
+    }
+    fprintf(file, "  }\n");
+    fprintf(file, "}\n");
+
+    fclose(file);
+
+    printf("Benchmark: %d quadros, min %.2f ms, media %.2f ms, p99 %.2f ms, max %.2f ms. Resultados em \"%s\".\n",
+           frame.count, frame.min, frame.avg, frame.p99, frame.max, filename);
+}
+
 // Definimos o callback para impressão de erros da GLFW no terminal
 void ErrorCallback(int error, const char* description)
 {
@@ -1269,26 +3202,27 @@ void TextRendering_Count(GLFWwindow* window)
     // Variáveis estáticas (static) mantém seus valores entre chamadas
     // subsequentes da função!
     //static float old_seconds = (float)glfwGetTime();
-    static char  buffer[20];
     static int   numchars = 7;
+    static int   layout = TextRendering_CreateLayout();
 
     // Recuperamos o número de segundos que passou desde a execução do programa
-    float seconds = (float)glfwGetTime();
+    float seconds = (float)GetGameTime();
 
+    const char* text;
     if (seconds <= 1.2f) {
-        strcpy(buffer, " 3");
+        text = " 3";
     }
     else if (seconds <= 2.4f) {
-        strcpy(buffer, " 2");
+        text = " 2";
     }
     else if (seconds <= 3.6f) {
-        strcpy(buffer, " 1");
+        text = " 1";
     }
     else if (seconds <= 4.8f) {
-        strcpy(buffer, "GO!");
+        text = "GO!";
     }
     else {
-        strcpy(buffer, "");
+        text = "";
     }
 
 
@@ -1296,7 +3230,7 @@ void TextRendering_Count(GLFWwindow* window)
     float charwidth = TextRendering_CharWidth(window);
 
     //TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-lineheight, 1.0f);
-    TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth - 0.9, 1.0f-lineheight-0.5, 4.0f);
+    TextRendering_PrintLayout(window, layout, text, 1.0f-(numchars + 1)*charwidth - 0.9, 1.0f-lineheight-0.5, 4.0f);
 }
 
 void TextRendering_ShowPontuacao(GLFWwindow* window)
@@ -1306,10 +3240,43 @@ void TextRendering_ShowPontuacao(GLFWwindow* window)
 
     float pad = TextRendering_LineHeight(window);
 
-    char buffer[80];
-    snprintf(buffer, 80, "Points : %d\n", main_points);
+    // O texto somente é formatado novamente quando a pontuação muda
+    static int  layout = TextRendering_CreateLayout();
+    static int  points = -1;
+    static char buffer[80];
+    if ( points != g_RenderState->points )
+    {
+        points = g_RenderState->points;
+        snprintf(buffer, 80, "Points : %d\n", points);
+    }
+
+    TextRendering_PrintLayout(window, layout, buffer, -1.0f+pad/10, -1.0f+2*pad/10, 1.0f);
+}
+
+// Tela exibida enquanto as threads de carregamento leem os recursos do
+// disco. A cada quadro, os recursos já decodificados são enviados para a GPU
+// por AssetLoader_Update(); a função retorna quando todos foram carregados.
+void ShowLoadingScreen(GLFWwindow* window)
+{
+    while ( !AssetLoader_Update() )
+    {
+        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        int finished;
+        int total;
+        AssetLoader_GetProgress(&finished, &total);
+
+        char buffer[80];
+        snprintf(buffer, 80, "Carregando... %d/%d", finished, total);
 
-    TextRendering_PrintString(window, buffer, -1.0f+pad/10, -1.0f+2*pad/10, 1.0f);
+        float charwidth = TextRendering_CharWidth(window);
+        TextRendering_PrintString(window, buffer, -(float)strlen(buffer)*charwidth/2.0f, 0.0f, 1.0f);
+        TextRendering_Flush();
+
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
 }
 
 void TextRendering_ShowTimeOut(GLFWwindow* window)
@@ -1319,10 +3286,12 @@ void TextRendering_ShowTimeOut(GLFWwindow* window)
 
     float pad = TextRendering_LineHeight(window);
 
-    char buffer[80];
+    static int  layout = TextRendering_CreateLayout();
+    static int  shownTime = -1;
+    static char buffer[80];
 
 
-    int showTime = (int)glfwGetTime();
+    int showTime = (int)g_RenderState->time;
 
     if (showTime >= 3) {
         showTime -= 3;
@@ -1336,11 +3305,16 @@ void TextRendering_ShowTimeOut(GLFWwindow* window)
 
     static int   numchars = 12;
 
-    snprintf(buffer, 80, "Tempo : %d/%d\n", showTime, time_out);
+    // O texto somente é formatado novamente uma vez por segundo
+    if ( shownTime != showTime )
+    {
+        shownTime = showTime;
+        snprintf(buffer, 80, "Tempo : %d/%d\n", showTime, time_out);
+    }
 
     float charwidth = TextRendering_CharWidth(window);
 
-    TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth - 0.025f, -1.0f+2*pad/10, 1.0f);
+    TextRendering_PrintLayout(window, layout, buffer, 1.0f-(numchars + 1)*charwidth - 0.025f, -1.0f+2*pad/10, 1.0f);
 }
 
 void TextRendering_GameOver(GLFWwindow* window) {
@@ -1348,44 +3322,47 @@ void TextRendering_GameOver(GLFWwindow* window) {
     if ( !g_ShowInfoText )
         return;
 
-    char buffer[80];
-    char gastal[80];
+    static int  layout = TextRendering_CreateLayout();
+    static int  gastal_layout = TextRendering_CreateLayout();
+    static int  points = -1;
+    static char gastal[80];
 
     static int numchars;
-    if (glfwGetTime() >= time_out+3.61f) {
+    if (g_RenderState->time >= time_out+3.61f) {
 
-        if(main_points == BOX_AMT) {
+        if(g_RenderState->points == BOX_AMT) {
             numchars = 11;
-            snprintf(buffer, 80, "You WON !!!");
 
             float lineheight = TextRendering_LineHeight(window);
             float charwidth = TextRendering_CharWidth(window);
 
             //TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-lineheight, 1.0f);
-            TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth - 0.9, 1.0f-lineheight-0.5, 2.0f);
+            TextRendering_PrintLayout(window, layout, "You WON !!!", 1.0f-(numchars + 1)*charwidth - 0.9, 1.0f-lineheight-0.5, 2.0f);
         }
         else {
             numchars = 10;
-            snprintf(buffer, 80, "You LOST");
-            snprintf(gastal, 80, "Points: %d", main_points);
+            if ( points != g_RenderState->points )
+            {
+                points = g_RenderState->points;
+                snprintf(gastal, 80, "Points: %d", points);
+            }
 
             float lineheight = TextRendering_LineHeight(window);
             float charwidth = TextRendering_CharWidth(window);
 
             //TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-lineheight, 1.0f);
-            TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth - 0.9, 1.0f-lineheight-0.5, 2.0f);
-            TextRendering_PrintString(window, gastal, 1.0f-(numchars + 1)*charwidth - 0.9, 1.0f-lineheight-0.75, 2.0f);
+            TextRendering_PrintLayout(window, layout, "You LOST", 1.0f-(numchars + 1)*charwidth - 0.9, 1.0f-lineheight-0.5, 2.0f);
+            TextRendering_PrintLayout(window, gastal_layout, gastal, 1.0f-(numchars + 1)*charwidth - 0.9, 1.0f-lineheight-0.75, 2.0f);
         }
     }
     else {
         numchars = 1;
-        snprintf(buffer, 80, " ");
 
         float lineheight = TextRendering_LineHeight(window);
         float charwidth = TextRendering_CharWidth(window);
 
         //TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-lineheight, 1.0f);
-        TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth - 0.9, 1.0f-lineheight-0.5, 2.0f);
+        TextRendering_PrintLayout(window, layout, " ", 1.0f-(numchars + 1)*charwidth - 0.9, 1.0f-lineheight-0.5, 2.0f);
     }
 
 
@@ -1395,6 +3372,83 @@ void TextRendering_GameOver(GLFWwindow* window) {
 }
 
 
+// Escrevemos na tela quantos objetos foram desenhados e quantos foram
+// descartados pelo frustum culling no quadro atual. Veja a tecla F em KeyCallback().
+void TextRendering_ShowCullingStats(GLFWwindow* window)
+{
+    if ( !g_ShowCullingStats )
+        return;
+
+    float lineheight = TextRendering_LineHeight(window);
+
+    static int  layout = TextRendering_CreateLayout();
+    static int  drawn = -1;
+    static int  culled = -1;
+    static char buffer[80];
+    if ( drawn != g_DrawnObjects || culled != g_CulledObjects )
+    {
+        drawn = g_DrawnObjects;
+        culled = g_CulledObjects;
+        snprintf(buffer, 80, "Desenhados: %d  Descartados: %d", drawn, culled);
+    }
+
+    TextRendering_PrintLayout(window, layout, buffer, -1.0f+lineheight/10, 1.0f-lineheight, 1.0f);
+}
+
+// Escrevemos na tela os tempos medidos pelo profiler nos últimos quadros: o
+// mínimo, a média, o percentil 99 e o máximo do tempo de cada quadro, e os
+// tempos de CPU e de GPU (média e percentil 99) de cada seção, com uma barra
+// proporcional ao maior percentil 99. A barra inteira corresponde a um
+// quadro a 60 Hz. Veja a tecla T em KeyCallback().
+void TextRendering_ShowProfiler(GLFWwindow* window)
+{
+    if ( !g_ShowProfiler )
+        return;
+
+    const float frame_budget = 1000.0f / 60.0f;
+    const int   bar_width = 30;
+    const float scale = 0.5f;
+
+    float lineheight = TextRendering_LineHeight(window);
+    float x = -1.0f + lineheight/10;
+    float y = 1.0f - 2*lineheight;
+    lineheight *= scale;
+
+    ProfilerStats frame;
+    Profiler_GetFrameStats(&frame);
+
+    char buffer[128];
+    snprintf(buffer, 128, "Quadro (ms): min %.2f  media %.2f  p99 %.2f  max %.2f", frame.min, frame.avg, frame.p99, frame.max);
+    TextRendering_PrintString(window, buffer, x, y, scale);
+
+    for (int section = 0; section < PROFILER_NUM_SECTIONS; ++section)
+    {
+        ProfilerStats cpu;
+        ProfilerStats gpu;
+        Profiler_GetSectionStats(section, &cpu, &gpu);
+
+        char gpu_text[32];
+        if ( gpu.count > 0 )
+            snprintf(gpu_text, 32, "%5.2f/%5.2f", gpu.avg, gpu.p99);
+        else
+            snprintf(gpu_text, 32, "     -     ");
+
+        char bar[bar_width + 1];
+        int length = (int)(std::max(cpu.p99, gpu.p99) / frame_budget * bar_width + 0.5f);
+        length = std::min(std::max(length, 0), bar_width);
+        memset(bar, '#', length);
+        memset(bar + length, '.', bar_width - length);
+        bar[bar_width] = '\0';
+
+        snprintf(buffer, 128, "%-9s cpu %5.2f/%5.2f  gpu %s  %s", Profiler_SectionName(section), cpu.avg, cpu.p99, gpu_text, bar);
+        TextRendering_PrintString(window, buffer, x, y - (section + 1)*lineheight, scale);
+    }
+
+    snprintf(buffer, 128, "Resolucao %s: %3d%% (%dx%d)", g_DynamicResolution ? "dinamica" : "fixa", (int)(g_ResolutionScale*100.0f + 0.5f),
+             std::max(1, (int)(g_FramebufferWidth * g_ResolutionScale + 0.5f)), std::max(1, (int)(g_FramebufferHeight * g_ResolutionScale + 0.5f)));
+    TextRendering_PrintString(window, buffer, x, y - (PROFILER_NUM_SECTIONS + 1)*lineheight, scale);
+}
+
 // Escrevemos na tela o número de quadros renderizados por segundo (frames per
 // second).
 void TextRendering_ShowFramesPerSecond(GLFWwindow* window)
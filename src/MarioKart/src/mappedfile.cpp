@@ -0,0 +1,75 @@
+// Arquivos mapeados em memória. Veja "mappedfile.h".
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/stat.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "mappedfile.h"
+
+bool MappedFile_Open(const char* filename, const char* source_filename, MappedFile& file)
+{
+    memset(&file, 0, sizeof(file));
+
+    struct stat file_stat;
+    if ( stat(filename, &file_stat) != 0 || file_stat.st_size == 0 )
+        return false;
+
+    // Um arquivo mais antigo que o arquivo original está desatualizado
+    struct stat source_stat;
+    if ( source_filename != NULL && stat(source_filename, &source_stat) == 0 && source_stat.st_mtime > file_stat.st_mtime )
+        return false;
+
+    file.size = file_stat.st_size;
+
+#if defined(_WIN32)
+    // Sem mmap(), lemos o arquivo inteiro de uma só vez
+    FILE* f = fopen(filename, "rb");
+    if ( f == NULL )
+        return false;
+
+    file.data = malloc(file.size);
+    bool ok = file.data != NULL && fread(file.data, 1, file.size, f) == file.size;
+    fclose(f);
+
+    if ( !ok )
+    {
+        MappedFile_Close(file);
+        return false;
+    }
+#else
+    int fd = open(filename, O_RDONLY);
+    if ( fd < 0 )
+        return false;
+
+    file.data = mmap(NULL, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if ( file.data == MAP_FAILED )
+    {
+        file.data = NULL;
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+void MappedFile_Close(MappedFile& file)
+{
+    if ( file.data != NULL )
+    {
+#if defined(_WIN32)
+        free(file.data);
+#else
+        munmap(file.data, file.size);
+#endif
+    }
+
+    memset(&file, 0, sizeof(file));
+}
@@ -0,0 +1,119 @@
+// Leitura e escrita de malhas pré-processadas. Veja "meshfile.h".
+#include <cstdio>
+#include <cstring>
+
+#include "meshfile.h"
+
+std::string MeshFile_CookedFilename(const char* obj_filename)
+{
+    std::string filename = obj_filename;
+
+    size_t dot = filename.find_last_of('.');
+    size_t slash = filename.find_last_of("/\\");
+    if ( dot != std::string::npos && (slash == std::string::npos || dot > slash) )
+        filename.erase(dot);
+
+    return filename + ".mesh";
+}
+
+bool MeshFile_Write(const char* filename, const MeshData& mesh)
+{
+    MeshFileHeader header;
+    header.magic        = MESH_FILE_MAGIC;
+    header.version      = MESH_FILE_VERSION;
+    header.num_shapes   = mesh.shapes.size();
+    header.num_vertices = mesh.vertices.size();
+    header.num_indices  = mesh.indices.size();
+    header.reserved     = 0;
+
+    FILE* file = fopen(filename, "wb");
+    if ( file == NULL )
+        return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+           && fwrite(mesh.shapes.data(),   sizeof(MeshShape),    mesh.shapes.size(),   file) == mesh.shapes.size()
+           && fwrite(mesh.vertices.data(), sizeof(SceneVertex),  mesh.vertices.size(), file) == mesh.vertices.size()
+           && fwrite(mesh.indices.data(),  sizeof(unsigned int), mesh.indices.size(),  file) == mesh.indices.size();
+
+    if ( fclose(file) != 0 )
+        ok = false;
+
+    return ok;
+}
+
+// Verifica se os objetos e os índices de um arquivo já mapeado referenciam
+// somente dados dentro do arquivo. Um arquivo truncado ou de um formato
+// antigo pode ter o tamanho esperado e ainda assim conter valores inválidos.
+static bool MeshFile_Validate(const MeshFile& file)
+{
+    const MeshFileHeader* header = file.header;
+
+    for (unsigned int i = 0; i < header->num_shapes; ++i)
+    {
+        const MeshShape& shape = file.shapes[i];
+
+        if ( memchr(shape.name, '\0', MESH_SHAPE_NAME_LENGTH) == NULL )
+            return false;
+
+        if ( shape.num_levels_of_detail < 1 || shape.num_levels_of_detail > MAX_LEVELS_OF_DETAIL )
+            return false;
+
+        // Todos os níveis são verificados, pois os inexistentes repetem o último
+        for (int lod = 0; lod < MAX_LEVELS_OF_DETAIL; ++lod)
+            if ( shape.first_index[lod] > header->num_indices
+              || shape.num_indices[lod] > header->num_indices - shape.first_index[lod] )
+                return false;
+    }
+
+    for (unsigned int i = 0; i < header->num_indices; ++i)
+        if ( file.indices[i] >= header->num_vertices )
+            return false;
+
+    return true;
+}
+
+bool MeshFile_Open(const char* filename, const char* source_filename, MeshFile& file)
+{
+    memset(&file, 0, sizeof(file));
+
+    if ( !MappedFile_Open(filename, source_filename, file.mapping) )
+        return false;
+
+    const char* bytes = (const char*)file.mapping.data;
+    file.header = (const MeshFileHeader*)bytes;
+
+    if ( file.mapping.size < sizeof(MeshFileHeader) || file.header->magic != MESH_FILE_MAGIC || file.header->version != MESH_FILE_VERSION )
+    {
+        MeshFile_Close(file);
+        return false;
+    }
+
+    size_t shapes_offset   = sizeof(MeshFileHeader);
+    size_t vertices_offset = shapes_offset   + (size_t)file.header->num_shapes   * sizeof(MeshShape);
+    size_t indices_offset  = vertices_offset + (size_t)file.header->num_vertices * sizeof(SceneVertex);
+    size_t end_offset      = indices_offset  + (size_t)file.header->num_indices  * sizeof(unsigned int);
+
+    if ( end_offset != file.mapping.size )
+    {
+        MeshFile_Close(file);
+        return false;
+    }
+
+    file.shapes   = (const MeshShape*)(bytes + shapes_offset);
+    file.vertices = (const SceneVertex*)(bytes + vertices_offset);
+    file.indices  = (const unsigned int*)(bytes + indices_offset);
+
+    if ( !MeshFile_Validate(file) )
+    {
+        MeshFile_Close(file);
+        return false;
+    }
+
+    return true;
+}
+
+void MeshFile_Close(MeshFile& file)
+{
+    MappedFile_Close(file.mapping);
+    memset(&file, 0, sizeof(file));
+}
@@ -0,0 +1,849 @@
+// Pré-processamento de malhas de triângulos. Veja "meshprocessing.h".
+//
+// A otimização de cache de vértices segue o algoritmo descrito em
+//   https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/geometric.hpp>
+
+#include "meshprocessing.h"
+
+// Hash FNV-1a de um bloco de memória
+static size_t HashBytes(const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    size_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Funções de hash e de igualdade de MeshVertex, comparando os bytes de todos
+// os atributos, para uso em std::unordered_map.
+struct MeshVertexHash
+{
+    size_t operator()(const MeshVertex& vertex) const
+    {
+        return HashBytes(&vertex, sizeof(MeshVertex));
+    }
+};
+
+struct MeshVertexEqual
+{
+    bool operator()(const MeshVertex& a, const MeshVertex& b) const
+    {
+        return memcmp(&a, &b, sizeof(MeshVertex)) == 0;
+    }
+};
+
+// Análogas às acima, comparando somente a posição dos vértices
+struct MeshPositionHash
+{
+    size_t operator()(const MeshVertex& vertex) const
+    {
+        return HashBytes(vertex.position, sizeof(vertex.position));
+    }
+};
+
+struct MeshPositionEqual
+{
+    bool operator()(const MeshVertex& a, const MeshVertex& b) const
+    {
+        return memcmp(a.position, b.position, sizeof(a.position)) == 0;
+    }
+};
+
+void MeshProcessing_WeldVertices(const std::vector<MeshVertex>& unindexed, std::vector<MeshVertex>& vertices, std::vector<unsigned int>& indices)
+{
+    std::unordered_map<MeshVertex, unsigned int, MeshVertexHash, MeshVertexEqual> unique_vertices;
+    unique_vertices.reserve(unindexed.size());
+
+    vertices.clear();
+    indices.clear();
+    indices.reserve(unindexed.size());
+
+    for (size_t i = 0; i < unindexed.size(); ++i)
+    {
+        std::pair<std::unordered_map<MeshVertex, unsigned int, MeshVertexHash, MeshVertexEqual>::iterator, bool> inserted
+            = unique_vertices.insert(std::make_pair(unindexed[i], (unsigned int)vertices.size()));
+
+        if ( inserted.second )
+            vertices.push_back(unindexed[i]);
+
+        indices.push_back(inserted.first->second);
+    }
+}
+
+// Parâmetros do algoritmo de Forsyth. A cache simulada é maior que a de
+// qualquer GPU atual; o algoritmo é pouco sensível ao tamanho exato.
+#define VERTEX_CACHE_SIZE         32
+#define CACHE_DECAY_POWER         1.5f
+#define LAST_TRIANGLE_SCORE       0.75f
+#define VALENCE_BOOST_SCALE       2.0f
+#define VALENCE_BOOST_POWER       0.5f
+
+// Pontuação de um vértice, dada a sua posição na cache (-1 se fora dela) e o
+// número de triângulos ainda não emitidos que o utilizam. Vértices recém
+// utilizados e vértices com poucos triângulos restantes têm prioridade.
+static float VertexScore(int cache_position, unsigned int remaining_triangles)
+{
+    if ( remaining_triangles == 0 )
+        return -1.0f;
+
+    float score = 0.0f;
+    if ( cache_position >= 0 )
+    {
+        if ( cache_position < 3 )
+        {
+            // Vértices do último triângulo emitido: pontuação fixa, para não
+            // favorecer a emissão de triângulos em leque (fan)
+            score = LAST_TRIANGLE_SCORE;
+        }
+        else
+        {
+            const float scaler = 1.0f / (VERTEX_CACHE_SIZE - 3);
+            score = powf(1.0f - (cache_position - 3) * scaler, CACHE_DECAY_POWER);
+        }
+    }
+
+    score += VALENCE_BOOST_SCALE * powf((float)remaining_triangles, -VALENCE_BOOST_POWER);
+
+    return score;
+}
+
+void MeshProcessing_OptimizeVertexCache(unsigned int* indices, size_t num_indices, size_t num_vertices)
+{
+    const size_t num_triangles = num_indices / 3;
+    if ( num_triangles == 0 )
+        return;
+
+    // Lista dos triângulos de cada vértice: os triângulos do vértice v estão
+    // em adjacency[first_triangle[v] .. first_triangle[v] + remaining[v]).
+    // Triângulos emitidos são removidos do final da lista de cada vértice.
+    std::vector<unsigned int> remaining(num_vertices, 0);
+    for (size_t i = 0; i < num_indices; ++i)
+        remaining[indices[i]] += 1;
+
+    std::vector<unsigned int> first_triangle(num_vertices, 0);
+    for (size_t v = 1; v < num_vertices; ++v)
+        first_triangle[v] = first_triangle[v-1] + remaining[v-1];
+
+    std::vector<unsigned int> adjacency(num_indices);
+    std::vector<unsigned int> fill(num_vertices, 0);
+    for (size_t t = 0; t < num_triangles; ++t)
+    {
+        for (size_t k = 0; k < 3; ++k)
+        {
+            unsigned int v = indices[3*t + k];
+            adjacency[first_triangle[v] + fill[v]] = t;
+            fill[v] += 1;
+        }
+    }
+
+    std::vector<int>   cache_position(num_vertices, -1);
+    std::vector<float> vertex_score(num_vertices);
+    for (size_t v = 0; v < num_vertices; ++v)
+        vertex_score[v] = VertexScore(-1, remaining[v]);
+
+    std::vector<float> triangle_score(num_triangles);
+    std::vector<bool>  emitted(num_triangles, false);
+    for (size_t t = 0; t < num_triangles; ++t)
+        triangle_score[t] = vertex_score[indices[3*t]] + vertex_score[indices[3*t+1]] + vertex_score[indices[3*t+2]];
+
+    std::vector<unsigned int> output;
+    output.reserve(num_indices);
+
+    unsigned int cache[VERTEX_CACHE_SIZE + 3];
+    size_t cache_count = 0;
+
+    int best_triangle = -1;
+
+    for (size_t n = 0; n < num_triangles; ++n)
+    {
+        // Se nenhum triângulo com vértices na cache está disponível, buscamos
+        // o de maior pontuação entre todos os restantes.
+        if ( best_triangle < 0 )
+        {
+            float best_score = -1.0f;
+            for (size_t t = 0; t < num_triangles; ++t)
+            {
+                if ( !emitted[t] && triangle_score[t] > best_score )
+                {
+                    best_score = triangle_score[t];
+                    best_triangle = t;
+                }
+            }
+        }
+
+        // Emitimos o triângulo escolhido e o removemos das listas dos seus vértices
+        const unsigned int* triangle = &indices[3*best_triangle];
+        emitted[best_triangle] = true;
+
+        for (size_t k = 0; k < 3; ++k)
+        {
+            unsigned int v = triangle[k];
+            output.push_back(v);
+
+            unsigned int* list = &adjacency[first_triangle[v]];
+            for (size_t i = 0; i < remaining[v]; ++i)
+            {
+                if ( list[i] == (unsigned int)best_triangle )
+                {
+                    list[i] = list[remaining[v] - 1];
+                    break;
+                }
+            }
+            remaining[v] -= 1;
+        }
+
+        // Nova cache: os vértices do triângulo emitido na frente, seguidos
+        // dos vértices que já estavam na cache. Os que passam do tamanho da
+        // cache são descartados ao final.
+        unsigned int new_cache[VERTEX_CACHE_SIZE + 3];
+        size_t new_cache_count = 0;
+        for (size_t k = 0; k < 3; ++k)
+            new_cache[new_cache_count++] = triangle[k];
+        for (size_t i = 0; i < cache_count; ++i)
+        {
+            unsigned int v = cache[i];
+            if ( v != triangle[0] && v != triangle[1] && v != triangle[2] )
+                new_cache[new_cache_count++] = v;
+        }
+
+        // Atualizamos as pontuações dos vértices afetados e dos seus
+        // triângulos, escolhendo o melhor destes para a próxima iteração.
+        for (size_t i = 0; i < new_cache_count; ++i)
+        {
+            unsigned int v = new_cache[i];
+            cache_position[v] = (i < VERTEX_CACHE_SIZE) ? (int)i : -1;
+            vertex_score[v] = VertexScore(cache_position[v], remaining[v]);
+        }
+
+        best_triangle = -1;
+        float best_score = -1.0f;
+        for (size_t i = 0; i < new_cache_count; ++i)
+        {
+            unsigned int v = new_cache[i];
+            const unsigned int* list = &adjacency[first_triangle[v]];
+            for (size_t j = 0; j < remaining[v]; ++j)
+            {
+                unsigned int t = list[j];
+                triangle_score[t] = vertex_score[indices[3*t]] + vertex_score[indices[3*t+1]] + vertex_score[indices[3*t+2]];
+                if ( triangle_score[t] > best_score )
+                {
+                    best_score = triangle_score[t];
+                    best_triangle = t;
+                }
+            }
+        }
+
+        cache_count = (new_cache_count < VERTEX_CACHE_SIZE) ? new_cache_count : VERTEX_CACHE_SIZE;
+        memcpy(cache, new_cache, cache_count * sizeof(unsigned int));
+    }
+
+    memcpy(indices, output.data(), num_indices * sizeof(unsigned int));
+}
+
+// Quádrica de erro: matriz simétrica 4x4 Q tal que o erro de um ponto p é
+// [p 1] Q [p 1]^T, a soma dos quadrados das distâncias de p aos planos
+// acumulados. Guardamos somente os 10 coeficientes distintos.
+struct Quadric
+{
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+};
+
+static void QuadricAdd(Quadric& q, const Quadric& other)
+{
+    q.a2 += other.a2; q.ab += other.ab; q.ac += other.ac; q.ad += other.ad;
+    q.b2 += other.b2; q.bc += other.bc; q.bd += other.bd;
+    q.c2 += other.c2; q.cd += other.cd;
+    q.d2 += other.d2;
+}
+
+static double QuadricError(const Quadric& q, const float* p)
+{
+    double x = p[0], y = p[1], z = p[2];
+    return q.a2*x*x + 2*q.ab*x*y + 2*q.ac*x*z + 2*q.ad*x
+         + q.b2*y*y + 2*q.bc*y*z + 2*q.bd*y
+         + q.c2*z*z + 2*q.cd*z
+         + q.d2;
+}
+
+// Normal (não normalizada) do triângulo (p0,p1,p2)
+static void TriangleNormal(const float* p0, const float* p1, const float* p2, double* n)
+{
+    double u[3] = { p1[0]-p0[0], p1[1]-p0[1], p1[2]-p0[2] };
+    double v[3] = { p2[0]-p0[0], p2[1]-p0[1], p2[2]-p0[2] };
+    n[0] = u[1]*v[2] - u[2]*v[1];
+    n[1] = u[2]*v[0] - u[0]*v[2];
+    n[2] = u[0]*v[1] - u[1]*v[0];
+}
+
+// Candidato a colapso: o vértice "from" é substituído pelo vértice "to"
+struct EdgeCollapse
+{
+    unsigned int from;
+    unsigned int to;
+    double       error;
+};
+
+static bool CompareEdgeCollapses(const EdgeCollapse& a, const EdgeCollapse& b)
+{
+    return a.error < b.error;
+}
+
+void MeshProcessing_Simplify(const std::vector<MeshVertex>& vertices, const unsigned int* indices, size_t num_indices, size_t target_num_indices, std::vector<unsigned int>& result)
+{
+    const size_t num_vertices = vertices.size();
+    result.assign(indices, indices + num_indices);
+
+    // Vértices com a mesma posição formam uma única classe, representada pelo
+    // primeiro deles (canonical). A topologia, as quádricas e os colapsos são
+    // computados sobre as classes; os índices em "result" continuam
+    // referenciando os vértices originais, preservando os seus atributos.
+    std::vector<unsigned int> canonical(num_vertices);
+    std::vector<unsigned int> class_size(num_vertices, 0);
+    {
+        std::unordered_map<MeshVertex, unsigned int, MeshPositionHash, MeshPositionEqual> classes;
+        std::vector<bool> counted(num_vertices, false);
+        for (size_t i = 0; i < num_indices; ++i)
+        {
+            unsigned int v = indices[i];
+            canonical[v] = classes.insert(std::make_pair(vertices[v], v)).first->second;
+            if ( !counted[v] )
+            {
+                counted[v] = true;
+                class_size[canonical[v]] += 1;
+            }
+        }
+    }
+
+    // Vértices que não podem ser removidos: costuras de atributos (classes com
+    // mais de um vértice) e bordas (arestas usadas por um único triângulo).
+    std::vector<bool> locked(num_vertices, false);
+    {
+        std::unordered_map<unsigned long long, unsigned int> edge_count;
+        for (size_t i = 0; i < num_indices; i += 3)
+        {
+            for (size_t k = 0; k < 3; ++k)
+            {
+                unsigned long long a = canonical[indices[i + k]];
+                unsigned long long b = canonical[indices[i + (k+1)%3]];
+                unsigned long long key = (a < b) ? (a << 32 | b) : (b << 32 | a);
+                edge_count[key] += 1;
+            }
+        }
+
+        for (std::unordered_map<unsigned long long, unsigned int>::iterator it = edge_count.begin(); it != edge_count.end(); ++it)
+        {
+            if ( it->second == 1 )
+            {
+                locked[it->first >> 32] = true;
+                locked[it->first & 0xFFFFFFFFu] = true;
+            }
+        }
+
+        for (size_t v = 0; v < num_vertices; ++v)
+        {
+            if ( class_size[v] > 1 )
+                locked[v] = true;
+        }
+    }
+
+    // Quádrica de cada classe: planos dos triângulos que a utilizam,
+    // ponderados pela área de cada triângulo.
+    Quadric zero = { 0,0,0,0,0,0,0,0,0,0 };
+    std::vector<Quadric> quadrics(num_vertices, zero);
+    for (size_t i = 0; i < num_indices; i += 3)
+    {
+        unsigned int c[3] = { canonical[indices[i]], canonical[indices[i+1]], canonical[indices[i+2]] };
+        const float* p0 = vertices[c[0]].position;
+
+        double n[3];
+        TriangleNormal(p0, vertices[c[1]].position, vertices[c[2]].position, n);
+        double length = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if ( length == 0.0 )
+            continue;
+
+        double a = n[0]/length, b = n[1]/length, cc = n[2]/length;
+        double d = -(a*p0[0] + b*p0[1] + cc*p0[2]);
+        double w = length * 0.5;
+
+        Quadric q = { w*a*a, w*a*b, w*a*cc, w*a*d, w*b*b, w*b*cc, w*b*d, w*cc*cc, w*cc*d, w*d*d };
+        for (size_t k = 0; k < 3; ++k)
+            QuadricAdd(quadrics[c[k]], q);
+    }
+
+    std::vector<unsigned int> remap(num_vertices);
+    for (size_t v = 0; v < num_vertices; ++v)
+        remap[v] = v;
+
+    std::vector<EdgeCollapse> collapses;
+    std::vector<unsigned int> first_triangle(num_vertices + 1);
+    std::vector<unsigned int> adjacency;
+    std::vector<bool>         touched(num_vertices);
+
+    // Cada passada escolhe os colapsos de menor erro que não afetam a mesma
+    // região da malha, aplica todos e remove os triângulos degenerados.
+    while ( result.size() > target_num_indices )
+    {
+        const size_t num_triangles = result.size() / 3;
+
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (size_t k = 0; k < 3; ++k)
+            {
+                unsigned int a = canonical[result[i + k]];
+                unsigned int b = canonical[result[i + (k+1)%3]];
+
+                Quadric q = quadrics[a];
+                QuadricAdd(q, quadrics[b]);
+
+                if ( !locked[a] )
+                {
+                    EdgeCollapse collapse = { a, b, QuadricError(q, vertices[b].position) };
+                    collapses.push_back(collapse);
+                }
+                if ( !locked[b] )
+                {
+                    EdgeCollapse collapse = { b, a, QuadricError(q, vertices[a].position) };
+                    collapses.push_back(collapse);
+                }
+            }
+        }
+
+        if ( collapses.empty() )
+            break;
+
+        std::sort(collapses.begin(), collapses.end(), CompareEdgeCollapses);
+
+        // Triângulos de cada classe, para o teste de inversão abaixo
+        std::fill(first_triangle.begin(), first_triangle.end(), 0);
+        for (size_t i = 0; i < result.size(); ++i)
+            first_triangle[canonical[result[i]] + 1] += 1;
+        for (size_t v = 0; v < num_vertices; ++v)
+            first_triangle[v + 1] += first_triangle[v];
+        adjacency.resize(result.size());
+        std::vector<unsigned int> fill(first_triangle.begin(), first_triangle.end() - 1);
+        for (size_t i = 0; i < result.size(); ++i)
+            adjacency[fill[canonical[result[i]]]++] = i / 3;
+
+        std::fill(touched.begin(), touched.end(), false);
+
+        size_t triangles_to_remove = (result.size() - target_num_indices + 2) / 3;
+        size_t triangles_removed = 0;
+        size_t num_collapses = 0;
+
+        for (size_t c = 0; c < collapses.size() && triangles_removed < triangles_to_remove; ++c)
+        {
+            unsigned int a = collapses[c].from;
+            unsigned int b = collapses[c].to;
+
+            if ( touched[a] || touched[b] )
+                continue;
+
+            // O colapso é rejeitado se inverter algum triângulo ao redor de "a"
+            bool flips = false;
+            size_t degenerate = 0;
+            for (unsigned int j = first_triangle[a]; j < first_triangle[a+1] && !flips; ++j)
+            {
+                unsigned int t = adjacency[j];
+                unsigned int tc[3] = { canonical[result[3*t]], canonical[result[3*t+1]], canonical[result[3*t+2]] };
+
+                if ( tc[0] == b || tc[1] == b || tc[2] == b )
+                {
+                    degenerate += 1;
+                    continue;
+                }
+
+                const float* p[3];
+                const float* q[3];
+                for (size_t k = 0; k < 3; ++k)
+                {
+                    p[k] = vertices[tc[k]].position;
+                    q[k] = (tc[k] == a) ? vertices[b].position : p[k];
+                }
+
+                double n0[3], n1[3];
+                TriangleNormal(p[0], p[1], p[2], n0);
+                TriangleNormal(q[0], q[1], q[2], n1);
+                if ( n0[0]*n1[0] + n0[1]*n1[1] + n0[2]*n1[2] <= 0.0 )
+                    flips = true;
+            }
+
+            if ( flips )
+                continue;
+
+            remap[a] = b;
+            QuadricAdd(quadrics[b], quadrics[a]);
+            triangles_removed += degenerate;
+            num_collapses += 1;
+
+            // Os vizinhos de "a" não podem colapsar nesta passada, pois os
+            // testes acima dependem das suas posições atuais.
+            for (unsigned int j = first_triangle[a]; j < first_triangle[a+1]; ++j)
+            {
+                unsigned int t = adjacency[j];
+                for (size_t k = 0; k < 3; ++k)
+                    touched[canonical[result[3*t + k]]] = true;
+            }
+        }
+
+        if ( num_collapses == 0 )
+            break;
+
+        // Aplicamos os colapsos e removemos os triângulos degenerados. Os
+        // vértices removidos nunca são costuras, então cada um corresponde
+        // ao próprio representante da sua classe.
+        size_t write = 0;
+        for (size_t t = 0; t < num_triangles; ++t)
+        {
+            unsigned int v[3];
+            for (size_t k = 0; k < 3; ++k)
+            {
+                v[k] = result[3*t + k];
+                unsigned int c = canonical[v[k]];
+                if ( remap[c] != c )
+                    v[k] = remap[c];
+            }
+
+            if ( canonical[v[0]] == canonical[v[1]] || canonical[v[1]] == canonical[v[2]] || canonical[v[0]] == canonical[v[2]] )
+                continue;
+
+            result[write++] = v[0];
+            result[write++] = v[1];
+            result[write++] = v[2];
+        }
+        result.resize(write);
+
+        for (size_t v = 0; v < num_vertices; ++v)
+            remap[v] = v;
+    }
+}
+
+void MeshProcessing_OptimizeVertexFetch(std::vector<MeshVertex>& vertices, std::vector<unsigned int>& indices)
+{
+    const unsigned int unused = (unsigned int)-1;
+    std::vector<unsigned int> remap(vertices.size(), unused);
+
+    std::vector<MeshVertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        unsigned int v = indices[i];
+        if ( remap[v] == unused )
+        {
+            remap[v] = reordered.size();
+            reordered.push_back(vertices[v]);
+        }
+        indices[i] = remap[v];
+    }
+
+    vertices.swap(reordered);
+}
+
+void MeshProcessing_ComputeNormals(tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes)
+{
+    size_t num_vertices = attrib.vertices.size() / 3;
+
+    std::vector<int> num_triangles_per_vertex(num_vertices, 0);
+    std::vector<glm::vec3> vertex_normals(num_vertices, glm::vec3(0.0f,0.0f,0.0f));
+
+    for (size_t shape = 0; shape < shapes.size(); ++shape)
+    {
+        size_t num_triangles = shapes[shape].mesh.num_face_vertices.size();
+
+        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
+        {
+            assert(shapes[shape].mesh.num_face_vertices[triangle] == 3);
+
+            glm::vec3  vertices[3];
+            for (size_t vertex = 0; vertex < 3; ++vertex)
+            {
+                tinyobj::index_t idx = shapes[shape].mesh.indices[3*triangle + vertex];
+                const float vx = attrib.vertices[3*idx.vertex_index + 0];
+                const float vy = attrib.vertices[3*idx.vertex_index + 1];
+                const float vz = attrib.vertices[3*idx.vertex_index + 2];
+                vertices[vertex] = glm::vec3(vx,vy,vz);
+            }
+
+            const glm::vec3  a = vertices[0];
+            const glm::vec3  b = vertices[1];
+            const glm::vec3  c = vertices[2];
+
+            const glm::vec3  n = glm::cross((b-a),(c-a))/glm::length(glm::cross((b-a),(c-a)));
+
+            for (size_t vertex = 0; vertex < 3; ++vertex)
+            {
+                tinyobj::index_t idx = shapes[shape].mesh.indices[3*triangle + vertex];
+                num_triangles_per_vertex[idx.vertex_index] += 1;
+                vertex_normals[idx.vertex_index] += n;
+                shapes[shape].mesh.indices[3*triangle + vertex].normal_index = idx.vertex_index;
+            }
+        }
+    }
+
+    attrib.normals.resize( 3*num_vertices );
+
+    for (size_t i = 0; i < vertex_normals.size(); ++i)
+    {
+        glm::vec3 n = vertex_normals[i] / (float)num_triangles_per_vertex[i];
+        n /= glm::length(n);
+        attrib.normals[3*i + 0] = n.x;
+        attrib.normals[3*i + 1] = n.y;
+        attrib.normals[3*i + 2] = n.z;
+    }
+}
+
+unsigned int MeshProcessing_PackNormal(const float normal[3])
+{
+    unsigned int packed = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        // Valores em [-1,1] são mapeados para inteiros em [-511,511]; os 2
+        // bits mais significativos (w) ficam em zero
+        float value = std::min(std::max(normal[i], -1.0f), 1.0f);
+        int   snorm = (int)std::round(value * 511.0f);
+        packed |= ((unsigned int)snorm & 0x3FF) << (10 * i);
+    }
+    return packed;
+}
+
+void MeshProcessing_UnpackNormal(unsigned int packed, float normal[3])
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        int snorm = (int)((packed >> (10 * i)) & 0x3FF);
+        if ( snorm & 0x200 )
+            snorm -= 0x400; // Extensão do sinal
+        normal[i] = std::max(snorm / 511.0f, -1.0f);
+    }
+}
+
+// Converte um float de 32 bits para 16 bits (half float), arredondando para
+// o valor mais próximo
+static unsigned int FloatToHalf(float value)
+{
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    unsigned int sign     = (bits >> 16) & 0x8000;
+    int          exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+    unsigned int mantissa = bits & 0x007FFFFF;
+
+    // Infinito ou NaN
+    if ( ((bits >> 23) & 0xFF) == 0xFF )
+        return sign | 0x7C00 | (mantissa != 0 ? 0x0200 : 0);
+
+    // Valores pequenos demais viram zero ou números subnormais
+    if ( exponent <= 0 )
+    {
+        if ( exponent < -10 )
+            return sign;
+
+        mantissa |= 0x00800000;
+        int shift = 14 - exponent;
+        unsigned int half = mantissa >> shift;
+        if ( (mantissa >> (shift - 1)) & 1 )
+            half += 1;
+        return sign | half;
+    }
+
+    mantissa += 0x00001000;
+    if ( mantissa & 0x00800000 )
+    {
+        mantissa = 0;
+        exponent += 1;
+    }
+
+    // Valores grandes demais viram infinito
+    if ( exponent >= 31 )
+        return sign | 0x7C00;
+
+    return sign | ((unsigned int)exponent << 10) | (mantissa >> 13);
+}
+
+unsigned int MeshProcessing_PackTexcoords(float u, float v)
+{
+    return FloatToHalf(u) | (FloatToHalf(v) << 16);
+}
+
+void MeshProcessing_BuildMesh(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, MeshData& mesh)
+{
+    // Primeiro geramos um vértice para cada canto de cada triângulo, como no
+    // arquivo OBJ, e guardamos o intervalo de triângulos de cada objeto.
+    std::vector<MeshVertex> unindexed;
+    std::vector<size_t>     shape_first_index;
+
+    mesh.shapes.assign(shapes.size(), MeshShape());
+
+    for (size_t shape = 0; shape < shapes.size(); ++shape)
+    {
+        shape_first_index.push_back(unindexed.size());
+        size_t num_triangles = shapes[shape].mesh.num_face_vertices.size();
+
+        // Axis-Aligned Bounding Box do objeto, em coordenadas locais
+        const float maxval = std::numeric_limits<float>::max();
+        glm::vec3 bbox_min = glm::vec3(maxval,maxval,maxval);
+        glm::vec3 bbox_max = glm::vec3(-maxval,-maxval,-maxval);
+
+        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
+        {
+            assert(shapes[shape].mesh.num_face_vertices[triangle] == 3);
+
+            for (size_t vertex = 0; vertex < 3; ++vertex)
+            {
+                tinyobj::index_t idx = shapes[shape].mesh.indices[3*triangle + vertex];
+
+                MeshVertex v;
+
+                const float vx = attrib.vertices[3*idx.vertex_index + 0];
+                const float vy = attrib.vertices[3*idx.vertex_index + 1];
+                const float vz = attrib.vertices[3*idx.vertex_index + 2];
+
+                bbox_min = glm::min(bbox_min, glm::vec3(vx,vy,vz));
+                bbox_max = glm::max(bbox_max, glm::vec3(vx,vy,vz));
+                v.position[0] = vx;
+                v.position[1] = vy;
+                v.position[2] = vz;
+
+                // Como os buffers são compartilhados entre todos os modelos,
+                // todo vértice precisa ter normal e coordenadas de textura;
+                // quando o modelo não as define, usamos zero (o mesmo valor
+                // que a OpenGL usaria para um atributo desabilitado).
+                if ( attrib.normals.size() >= (size_t)3*idx.normal_index )
+                {
+                    v.normal[0] = attrib.normals[3*idx.normal_index + 0];
+                    v.normal[1] = attrib.normals[3*idx.normal_index + 1];
+                    v.normal[2] = attrib.normals[3*idx.normal_index + 2];
+                }
+                else
+                {
+                    v.normal[0] = v.normal[1] = v.normal[2] = 0.0f;
+                }
+
+                if ( attrib.texcoords.size() >= (size_t)3*idx.texcoord_index )
+                {
+                    v.texcoord[0] = attrib.texcoords[2*idx.texcoord_index + 0];
+                    v.texcoord[1] = attrib.texcoords[2*idx.texcoord_index + 1];
+                }
+                else
+                {
+                    v.texcoord[0] = v.texcoord[1] = 0.0f;
+                }
+
+                unindexed.push_back(v);
+            }
+        }
+
+        MeshShape& s = mesh.shapes[shape];
+        strncpy(s.name, shapes[shape].name.c_str(), MESH_SHAPE_NAME_LENGTH - 1);
+        s.name[MESH_SHAPE_NAME_LENGTH - 1] = '\0';
+        for (int i = 0; i < 3; ++i)
+        {
+            s.bbox_min[i] = bbox_min[i];
+            s.bbox_max[i] = bbox_max[i];
+        }
+    }
+    shape_first_index.push_back(unindexed.size());
+
+    // Unimos os vértices repetidos e geramos os níveis de detalhe de cada
+    // objeto, cada um simplificado a partir do anterior. Os índices de todos
+    // os níveis de todos os objetos ficam em sequência em "indices", e os
+    // triângulos de cada nível são reordenados para a cache de vértices. Por
+    // fim, os vértices são reordenados na ordem de uso.
+    std::vector<MeshVertex>   vertices;
+    std::vector<unsigned int> welded_indices;
+    MeshProcessing_WeldVertices(unindexed, vertices, welded_indices);
+
+    std::vector<unsigned int>& indices = mesh.indices;
+    indices.clear();
+
+    for (size_t shape = 0; shape < shapes.size(); ++shape)
+    {
+        MeshShape& s = mesh.shapes[shape];
+
+        size_t first_index = shape_first_index[shape];
+        size_t num_indices = shape_first_index[shape+1] - first_index;
+
+        std::vector<unsigned int> lod_indices(welded_indices.begin() + first_index, welded_indices.begin() + first_index + num_indices);
+
+        unsigned int num_lods = 0;
+        while ( true )
+        {
+            MeshProcessing_OptimizeVertexCache(lod_indices.data(), lod_indices.size(), vertices.size());
+
+            s.first_index[num_lods] = indices.size();
+            s.num_indices[num_lods] = lod_indices.size();
+            indices.insert(indices.end(), lod_indices.begin(), lod_indices.end());
+            num_lods += 1;
+
+            if ( num_lods == MAX_LEVELS_OF_DETAIL || num_indices < 3*LOD_MIN_TRIANGLES )
+                break;
+
+            std::vector<unsigned int> simplified;
+            size_t target = (lod_indices.size() / 6) * 3;
+            MeshProcessing_Simplify(vertices, lod_indices.data(), lod_indices.size(), target, simplified);
+
+            // Paramos se a simplificação não conseguiu remover triângulos suficientes
+            if ( simplified.size() > lod_indices.size() * 3 / 4 )
+                break;
+
+            lod_indices.swap(simplified);
+        }
+
+        s.num_levels_of_detail = num_lods;
+        for (unsigned int lod = num_lods; lod < MAX_LEVELS_OF_DETAIL; ++lod)
+        {
+            s.first_index[lod] = s.first_index[num_lods - 1];
+            s.num_indices[lod] = s.num_indices[num_lods - 1];
+        }
+
+        // A linha é montada antes de ser impressa, com uma única chamada a
+        // printf(), pois vários modelos são processados ao mesmo tempo pelas
+        // threads de carregamento e as suas mensagens não podem se misturar
+        if ( num_lods > 1 )
+        {
+            char counts[64] = "";
+            for (unsigned int lod = 0; lod < num_lods; ++lod)
+            {
+                size_t length = strlen(counts);
+                snprintf(counts + length, sizeof(counts) - length, "%s%d", lod > 0 ? ", " : "", (int)s.num_indices[lod] / 3);
+            }
+            printf("Objeto \"%s\": %d níveis de detalhe (%s triângulos).\n", s.name, (int)num_lods, counts);
+        }
+    }
+
+    MeshProcessing_OptimizeVertexFetch(vertices, indices);
+
+    printf("Malha com %d vértices (%d antes da união de vértices repetidos).\n", (int)vertices.size(), (int)unindexed.size());
+
+    mesh.vertices.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        const MeshVertex& v = vertices[i];
+
+        // As normais são unitárias, então cabem em inteiros de 10 bits com
+        // sinal; as coordenadas de textura são guardadas como half floats.
+        SceneVertex& packed = mesh.vertices[i];
+        packed.position[0] = v.position[0];
+        packed.position[1] = v.position[1];
+        packed.position[2] = v.position[2];
+        packed.normal      = MeshProcessing_PackNormal(v.normal);
+        packed.texcoord    = MeshProcessing_PackTexcoords(v.texcoord[0], v.texcoord[1]);
+    }
+}
@@ -0,0 +1,209 @@
+// Medição do tempo dos quadros. Veja "profiler.h".
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "profiler.h"
+
+// Número de quadros entre o início de uma consulta GL_TIME_ELAPSED e a leitura
+// do seu resultado. Cada seção tem uma consulta por quadro em andamento.
+#define PROFILER_QUERY_FRAMES 4
+
+// Histórico circular dos últimos PROFILER_HISTORY valores de uma medida
+struct ProfilerHistory
+{
+    float values[PROFILER_HISTORY];
+    int   count;
+    int   next;
+};
+
+struct ProfilerSection
+{
+    const char*     name;
+    bool            gpu; // Se o tempo de GPU é medido
+    ProfilerHistory cpu_history;
+    ProfilerHistory gpu_history;
+    double          cpu_start;
+    GLuint          queries[PROFILER_QUERY_FRAMES];
+    bool            issued[PROFILER_QUERY_FRAMES]; // Se a consulta aguarda leitura
+};
+
+static ProfilerSection g_ProfilerSections[PROFILER_NUM_SECTIONS] =
+{
+    { "simulacao", false }, // Os nomes são exibidos com a fonte de
+    { "cena",      true  }, // "textrendering.cpp", que só possui
+    { "ceu",       true  }, // caracteres ASCII
+    { "escala",    true  },
+    { "texto",     true  },
+};
+
+static ProfilerHistory g_FrameHistory;
+static double          g_FrameStart = -1.0;
+static int             g_ProfilerFrame = 0;
+static float           g_LastGpuFrameTime = 0.0f; // Veja Profiler_GetLastGpuFrameTime()
+static int             g_LastGpuFrame = -1;
+
+double Profiler_GetTime()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void Profiler_Record(ProfilerHistory& history, float value)
+{
+    history.values[history.next] = value;
+    history.next = (history.next + 1) % PROFILER_HISTORY;
+    history.count = std::min(history.count + 1, PROFILER_HISTORY);
+}
+
+void Profiler_ComputeStats(const float* measurements, int count, ProfilerStats* stats)
+{
+    stats->count = count;
+    stats->min = stats->avg = stats->p99 = stats->max = 0.0f;
+    if ( count == 0 )
+        return;
+
+    std::vector<float> values(measurements, measurements + count);
+
+    double sum = 0.0;
+    for (size_t i = 0; i < values.size(); ++i)
+        sum += values[i];
+    stats->avg = (float)(sum / values.size());
+
+    // Percentil 99: o valor abaixo do qual estão 99% das medidas
+    size_t p99 = std::min(values.size() - 1, values.size() * 99 / 100);
+    std::nth_element(values.begin(), values.begin() + p99, values.end());
+    stats->p99 = values[p99];
+
+    stats->min = *std::min_element(values.begin(), values.end());
+    stats->max = *std::max_element(values.begin(), values.end());
+}
+
+static void Profiler_ComputeStats(const ProfilerHistory& history, ProfilerStats* stats)
+{
+    Profiler_ComputeStats(history.values, history.count, stats);
+}
+
+void Profiler_Init()
+{
+    for (int i = 0; i < PROFILER_NUM_SECTIONS; ++i)
+    {
+        ProfilerSection& section = g_ProfilerSections[i];
+        section.cpu_history.count = section.cpu_history.next = 0;
+        section.gpu_history.count = section.gpu_history.next = 0;
+
+        if ( section.gpu )
+            glGenQueries(PROFILER_QUERY_FRAMES, section.queries);
+        for (int j = 0; j < PROFILER_QUERY_FRAMES; ++j)
+            section.issued[j] = false;
+    }
+
+    g_FrameHistory.count = g_FrameHistory.next = 0;
+    g_FrameStart = -1.0;
+    g_ProfilerFrame = 0;
+    g_LastGpuFrame = -1;
+}
+
+void Profiler_BeginFrame()
+{
+    double now = Profiler_GetTime();
+    if ( g_FrameStart >= 0.0 )
+        Profiler_Record(g_FrameHistory, (float)(now - g_FrameStart));
+    g_FrameStart = now;
+
+    g_ProfilerFrame += 1;
+
+    // Lemos as consultas feitas PROFILER_QUERY_FRAMES quadros atrás, que
+    // serão reutilizadas neste quadro. Se a GPU ainda não terminou (o que
+    // só ocorre se ela está muitos quadros atrasada), o resultado é
+    // descartado ao invés de esperarmos por ele.
+    int   slot = g_ProfilerFrame % PROFILER_QUERY_FRAMES;
+    float frame_gpu_time = 0.0f;
+    bool  frame_measured = false;
+    bool  frame_complete = true;
+    for (int i = 0; i < PROFILER_NUM_SECTIONS; ++i)
+    {
+        ProfilerSection& section = g_ProfilerSections[i];
+        if ( !section.issued[slot] )
+            continue;
+        section.issued[slot] = false;
+
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(section.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if ( !available )
+        {
+            frame_complete = false;
+            continue;
+        }
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(section.queries[slot], GL_QUERY_RESULT, &elapsed);
+        Profiler_Record(section.gpu_history, (float)(elapsed / 1.0e6));
+
+        frame_gpu_time += (float)(elapsed / 1.0e6);
+        frame_measured = true;
+    }
+
+    // O total só é válido se todas as seções do quadro foram lidas
+    if ( frame_measured && frame_complete )
+    {
+        g_LastGpuFrameTime = frame_gpu_time;
+        g_LastGpuFrame = g_ProfilerFrame - PROFILER_QUERY_FRAMES;
+    }
+}
+
+void Profiler_Begin(int section_id)
+{
+    ProfilerSection& section = g_ProfilerSections[section_id];
+    section.cpu_start = Profiler_GetTime();
+
+    if ( section.gpu )
+        glBeginQuery(GL_TIME_ELAPSED, section.queries[g_ProfilerFrame % PROFILER_QUERY_FRAMES]);
+}
+
+void Profiler_End(int section_id)
+{
+    ProfilerSection& section = g_ProfilerSections[section_id];
+
+    if ( section.gpu )
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        section.issued[g_ProfilerFrame % PROFILER_QUERY_FRAMES] = true;
+    }
+
+    Profiler_Record(section.cpu_history, (float)(Profiler_GetTime() - section.cpu_start));
+}
+
+void Profiler_RecordCpuTime(int section_id, float milliseconds)
+{
+    Profiler_Record(g_ProfilerSections[section_id].cpu_history, milliseconds);
+}
+
+int Profiler_GetFrame()
+{
+    return g_ProfilerFrame;
+}
+
+int Profiler_GetLastGpuFrameTime(float* milliseconds)
+{
+    *milliseconds = g_LastGpuFrameTime;
+    return g_LastGpuFrame;
+}
+
+const char* Profiler_SectionName(int section)
+{
+    return g_ProfilerSections[section].name;
+}
+
+void Profiler_GetFrameStats(ProfilerStats* stats)
+{
+    Profiler_ComputeStats(g_FrameHistory, stats);
+}
+
+void Profiler_GetSectionStats(int section, ProfilerStats* cpu, ProfilerStats* gpu)
+{
+    Profiler_ComputeStats(g_ProfilerSections[section].cpu_history, cpu);
+    Profiler_ComputeStats(g_ProfilerSections[section].gpu_history, gpu);
+}
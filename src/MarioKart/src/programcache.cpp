@@ -0,0 +1,243 @@
+// Cache de programas de GPU. Veja "programcache.h".
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "programcache.h"
+#include "mappedfile.h"
+
+// Constantes e funções da extensão GL_ARB_get_program_binary
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH           0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS      0x87FE
+
+typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei buffer_size, GLsizei* length, GLenum* format, void* binary);
+typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum format, const void* binary, GLsizei length);
+typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum name, GLint value);
+
+static GetProgramBinaryProc  g_GetProgramBinary = NULL;
+static ProgramBinaryProc     g_ProgramBinary = NULL;
+static ProgramParameteriProc g_ProgramParameteri = NULL;
+
+// Binário de um programa, em memória
+struct ProgramBinary
+{
+    GLenum                     format;
+    std::vector<unsigned char> data;
+    bool                       used; // Se foi carregado ou guardado nesta execução
+};
+
+static bool                              g_ProgramCacheEnabled = false;
+static std::string                       g_ProgramCacheFilename;
+static std::string                       g_ProgramCacheDriver;
+static std::map<uint64_t, ProgramBinary> g_ProgramBinaries;
+static bool                              g_ProgramCacheModified = false;
+
+// Tamanho arredondado para cima até um múltiplo de 4 bytes
+static size_t ProgramCache_Align(size_t size)
+{
+    return (size + 3) & ~(size_t)3;
+}
+
+// Lê os binários do arquivo. Um arquivo inválido, de outra versão do formato
+// ou de outro driver é ignorado, e será sobrescrito por ProgramCache_Save().
+static void ProgramCache_Read()
+{
+    MappedFile mapping;
+    if ( !MappedFile_Open(g_ProgramCacheFilename.c_str(), NULL, mapping) )
+        return;
+
+    const unsigned char* data = (const unsigned char*)mapping.data;
+    const ProgramCacheHeader* header = (const ProgramCacheHeader*)data;
+
+    size_t offset = sizeof(ProgramCacheHeader);
+    bool valid = mapping.size >= offset
+              && header->magic == PROGRAM_CACHE_MAGIC
+              && header->version == PROGRAM_CACHE_VERSION
+              && header->driver_length == g_ProgramCacheDriver.size()
+              && offset + header->driver_length <= mapping.size
+              && memcmp(data + offset, g_ProgramCacheDriver.data(), header->driver_length) == 0;
+
+    if ( valid )
+    {
+        offset += ProgramCache_Align(header->driver_length);
+
+        for (unsigned int i = 0; i < header->num_entries; ++i)
+        {
+            if ( offset + sizeof(ProgramCacheEntry) > mapping.size )
+                break;
+
+            // As entradas são alinhadas em 4 bytes, e não em 8 como "key";
+            // por isso são copiadas ao invés de acessadas diretamente.
+            ProgramCacheEntry entry;
+            memcpy(&entry, data + offset, sizeof(entry));
+            offset += sizeof(ProgramCacheEntry);
+            if ( offset + entry.size > mapping.size )
+                break;
+
+            ProgramBinary& binary = g_ProgramBinaries[entry.key];
+            binary.format = entry.format;
+            binary.data.assign(data + offset, data + offset + entry.size);
+            binary.used   = false;
+
+            offset += ProgramCache_Align(entry.size);
+        }
+    }
+
+    MappedFile_Close(mapping);
+}
+
+void ProgramCache_Init(const char* filename, GLADloadproc load)
+{
+    g_GetProgramBinary  = (GetProgramBinaryProc)load("glGetProgramBinary");
+    g_ProgramBinary     = (ProgramBinaryProc)load("glProgramBinary");
+    g_ProgramParameteri = (ProgramParameteriProc)load("glProgramParameteri");
+
+    // O driver pode suportar a extensão sem suportar nenhum formato binário
+    GLint num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+
+    g_ProgramCacheEnabled = g_GetProgramBinary != NULL && g_ProgramBinary != NULL && g_ProgramParameteri != NULL && num_formats > 0;
+    if ( !g_ProgramCacheEnabled )
+        return;
+
+    g_ProgramCacheFilename = filename;
+    g_ProgramCacheDriver   = std::string((const char*)glGetString(GL_VENDOR)) + "\n"
+                           + (const char*)glGetString(GL_RENDERER) + "\n"
+                           + (const char*)glGetString(GL_VERSION);
+
+    g_ProgramBinaries.clear();
+    g_ProgramCacheModified = false;
+    ProgramCache_Read();
+}
+
+uint64_t ProgramCache_Key(const std::string& vertex_source, const std::string& fragment_source)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    // O caractere '\0' separa os dois códigos, que não o contêm
+    std::string sources = vertex_source + '\0' + fragment_source;
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        hash ^= (unsigned char)sources[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+GLuint ProgramCache_Load(uint64_t key)
+{
+    if ( !g_ProgramCacheEnabled )
+        return 0;
+
+    std::map<uint64_t, ProgramBinary>::iterator it = g_ProgramBinaries.find(key);
+    if ( it == g_ProgramBinaries.end() )
+        return 0;
+
+    GLuint program_id = glCreateProgram();
+    g_ProgramBinary(program_id, it->second.format, it->second.data.data(), it->second.data.size());
+
+    // O driver pode rejeitar um binário mesmo que ele tenha sido gerado com
+    // a mesma versão, por exemplo após uma mudança de configuração
+    GLint linked_ok = GL_FALSE;
+    glGetProgramiv(program_id, GL_LINK_STATUS, &linked_ok);
+    if ( linked_ok == GL_FALSE )
+    {
+        glDeleteProgram(program_id);
+        g_ProgramBinaries.erase(it);
+        g_ProgramCacheModified = true;
+        return 0;
+    }
+
+    it->second.used = true;
+    return program_id;
+}
+
+void ProgramCache_PrepareProgram(GLuint program_id)
+{
+    if ( g_ProgramCacheEnabled )
+        g_ProgramParameteri(program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache_Store(uint64_t key, GLuint program_id)
+{
+    if ( !g_ProgramCacheEnabled )
+        return;
+
+    GLint linked_ok = GL_FALSE;
+    glGetProgramiv(program_id, GL_LINK_STATUS, &linked_ok);
+
+    GLint length = 0;
+    glGetProgramiv(program_id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if ( linked_ok == GL_FALSE || length <= 0 )
+        return;
+
+    ProgramBinary& binary = g_ProgramBinaries[key];
+    binary.data.resize(length);
+    g_GetProgramBinary(program_id, length, &length, &binary.format, binary.data.data());
+    binary.data.resize(length);
+    binary.used = true;
+
+    g_ProgramCacheModified = true;
+}
+
+void ProgramCache_Save()
+{
+    if ( !g_ProgramCacheEnabled || !g_ProgramCacheModified )
+        return;
+
+    std::vector<uint64_t> keys;
+    for (std::map<uint64_t, ProgramBinary>::iterator it = g_ProgramBinaries.begin(); it != g_ProgramBinaries.end(); ++it)
+        if ( it->second.used )
+            keys.push_back(it->first);
+
+    ProgramCacheHeader header;
+    header.magic         = PROGRAM_CACHE_MAGIC;
+    header.version       = PROGRAM_CACHE_VERSION;
+    header.driver_length = g_ProgramCacheDriver.size();
+    header.num_entries   = keys.size();
+
+    static const unsigned char padding[3] = { 0, 0, 0 };
+
+    FILE* file = fopen(g_ProgramCacheFilename.c_str(), "wb");
+    if ( file == NULL )
+    {
+        fprintf(stderr, "WARNING: Cannot write program cache \"%s\".\n", g_ProgramCacheFilename.c_str());
+        return;
+    }
+
+    size_t driver_padding = ProgramCache_Align(g_ProgramCacheDriver.size()) - g_ProgramCacheDriver.size();
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+           && fwrite(g_ProgramCacheDriver.data(), 1, g_ProgramCacheDriver.size(), file) == g_ProgramCacheDriver.size()
+           && fwrite(padding, 1, driver_padding, file) == driver_padding;
+
+    for (size_t i = 0; ok && i < keys.size(); ++i)
+    {
+        const ProgramBinary& binary = g_ProgramBinaries[keys[i]];
+
+        ProgramCacheEntry entry;
+        entry.key    = keys[i];
+        entry.format = binary.format;
+        entry.size   = binary.data.size();
+
+        size_t data_padding = ProgramCache_Align(binary.data.size()) - binary.data.size();
+        ok = fwrite(&entry, sizeof(entry), 1, file) == 1
+          && fwrite(binary.data.data(), 1, binary.data.size(), file) == binary.data.size()
+          && fwrite(padding, 1, data_padding, file) == data_padding;
+    }
+
+    if ( fclose(file) != 0 )
+        ok = false;
+
+    // Um arquivo incompleto é removido, para não ser lido na próxima execução
+    if ( !ok )
+    {
+        fprintf(stderr, "WARNING: Cannot write program cache \"%s\".\n", g_ProgramCacheFilename.c_str());
+        remove(g_ProgramCacheFilename.c_str());
+        return;
+    }
+
+    g_ProgramCacheModified = false;
+}
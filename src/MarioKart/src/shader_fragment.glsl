@@ -7,10 +7,26 @@
 in vec4 position_world;
 in vec4 normal;
 
-// Matrizes computadas no código C++ e enviadas para a GPU
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Parâmetros computados no código C++ e enviados para a GPU. Estas
+// declarações devem ser idênticas às de "shader_vertex.glsl"; veja as
+// estruturas FrameUniforms e DrawUniforms em "main.cpp".
+layout (std140) uniform FrameUniforms
+{
+    mat4 view;
+    mat4 projection;
+    vec4 camera_position;
+    vec4 light_direction;
+    vec4 cluster_params;
+};
+
+layout (std140) uniform DrawUniforms
+{
+    mat4 model;
+    mat4 normal_matrix;
+    vec4 bbox_min;
+    vec4 bbox_max;
+    int  instanced;
+};
 
 // Posição do vértice atual no sistema de coordenadas local do modelo.
 in vec4 position_model;
@@ -18,11 +34,9 @@ in vec4 position_model;
 // Coordenadas de textura obtidas do arquivo OBJ (se existirem!)
 in vec2 texcoords;
 
-uniform vec4 bbox_min;
-uniform vec4 bbox_max;
 
 
-// Identificador que define qual objeto está sendo desenhado no momento
+// Identificadores dos materiais (objetos) da cena
 #define SPHERE 0
 #define BUNNY  1
 #define PLANE  2
@@ -33,17 +47,35 @@ uniform vec4 bbox_max;
 #define BOX 7
 #define ESTACA 8
 #define GOLDEN_COW 9
-uniform int object_id;
-
-// Variáveis para acesso das imagens de textura
-uniform sampler2D TextureImage0;
-uniform sampler2D TextureImage1;
-uniform sampler2D TextureImage2;
-uniform sampler2D TextureImage3;
-uniform sampler2D TextureImage4;
-uniform sampler2D TextureImage5;
-uniform sampler2D TextureImage6;
 
+// Material do objeto sendo desenhado. Este valor não é um uniform: o código em
+// "main.cpp" compila uma versão especializada deste shader para cada material,
+// definindo OBJECT_ID com #define (veja LoadShadersFromFiles()). Assim, cada
+// programa contém somente o código do seu material, sem desvios por fragmento.
+#ifndef OBJECT_ID
+#error "OBJECT_ID deve ser definido por LoadShadersFromFiles()"
+#endif
+
+// Textura do material. As imagens de mesmo tamanho são agrupadas em arrays
+// de texturas, e cada material amostra uma camada ("material_layer") de um
+// deles (veja CreateTextureArrays() em "main.cpp").
+uniform sampler2DArray material_texture;
+uniform float material_layer;
+
+// Fator de repetição das coordenadas de textura do material. As texturas que
+// se repetem sobre a superfície usam GL_REPEAT no sampler (veja
+// LoadTextureImage() em "main.cpp"), então basta escalar as coordenadas.
+uniform vec2 uv_scale;
+
+
+// Fontes de luz pontuais (caixas, chama do carro e postes), aplicadas com
+// iluminação "clustered forward". As luzes que alcançam cada cluster do
+// frustum são listadas na CPU a cada quadro (veja UpdateLightClusters() em
+// "main.cpp" e "lightclusters.h"); CLUSTER_TILES_X, CLUSTER_TILES_Y e
+// CLUSTER_SLICES são definidos por LoadShadersFromFiles().
+uniform samplerBuffer  light_data;     // (posição, raio) e (cor, 0) de cada luz
+uniform usamplerBuffer light_clusters; // (início, número) da lista de cada cluster
+uniform usamplerBuffer light_indices;  // Índices das luzes de todas as listas
 
 // O valor de saída ("out") de um Fragment Shader é a cor final do fragmento.
 out vec3 color;
@@ -52,12 +84,44 @@ out vec3 color;
 // Constantes
 #define M_PI   3.14159265358979323846
 #define M_PI_2 1.57079632679489661923
+
+// Soma das contribuições difusas (Lambert) das fontes de luz pontuais no
+// ponto "p", de normal "n". Somente as luzes do cluster do fragmento são
+// consideradas, e a intensidade de cada uma cai suavemente até zero no seu
+// raio.
+vec3 ClusteredLighting(vec4 p, vec4 n)
+{
+    // Cluster do fragmento: tile da tela e fatia exponencial de profundidade
+    // (cluster_params é computado em UpdateLightClusters())
+    ivec2 tile  = ivec2(gl_FragCoord.xy * cluster_params.xy);
+    float depth = max(-(view * p).z, cluster_params.w);
+    int   slice = int(log(depth / cluster_params.w) * cluster_params.z);
+
+    ivec3 cluster = clamp(ivec3(tile, slice), ivec3(0), ivec3(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1, CLUSTER_SLICES - 1));
+    uvec2 list = texelFetch(light_clusters, (cluster.z * CLUSTER_TILES_Y + cluster.y) * CLUSTER_TILES_X + cluster.x).xy;
+
+    vec3 irradiance = vec3(0.0);
+    for (uint i = 0u; i < list.y; ++i)
+    {
+        int  light = int(texelFetch(light_indices, int(list.x + i)).r);
+        vec4 position_radius = texelFetch(light_data, 2 * light);
+        vec3 light_color     = texelFetch(light_data, 2 * light + 1).rgb;
+
+        vec3  to_light = position_radius.xyz - p.xyz;
+        float dist2    = dot(to_light, to_light);
+        float falloff  = clamp(1.0 - dist2 / (position_radius.w * position_radius.w), 0.0, 1.0);
+        float lambert  = max(0.0, dot(n.xyz, to_light) * inversesqrt(max(dist2, 1e-4)));
+
+        irradiance += light_color * lambert * falloff * falloff;
+    }
+
+    return irradiance;
+}
+
 void main()
 {
-    // Obtemos a posição da câmera utilizando a inversa da matriz que define o
-    // sistema de coordenadas da câmera.
-    vec4 origin = vec4(0.0, 0.0, 0.0, 1.0);
-    vec4 camera_position = inverse(view) * origin;
+    // A posição da câmera (camera_position) é computada uma única vez por
+    // quadro, no código C++, a partir da inversa da matriz "view".
 
     // O fragmento atual é coberto por um ponto que percente à superfície de um
     // dos objetos virtuais da cena. Este ponto, p, possui uma posição no
@@ -71,7 +135,7 @@ void main()
     vec4 n = normalize(normal);
 
     // Vetor que define o sentido da fonte de luz em relação ao ponto atual.
-    vec4 l = normalize(vec4(0.0,1.0,0.0,0.0));
+    vec4 l = light_direction;
 
     // Vetor que define o sentido da câmera em relação ao ponto atual.
     vec4 v = normalize(camera_position - p);
@@ -90,7 +154,7 @@ void main()
 
     vec3 Kd1 = vec3(1.0f, 1.0f, 1.0f);
     vec3 Kd2 = vec3(1.0f, 1.0f, 1.0f);
-    if ( object_id == SPHERE )
+#if OBJECT_ID == SPHERE
     {
         // PREENCHA AQUI
         // Propriedades espectrais da esfera
@@ -101,7 +165,7 @@ void main()
         Ka = Kd;
         q = 1.0;
     }
-    else if ( object_id == GOLDEN_COW)
+#elif OBJECT_ID == GOLDEN_COW
     {
 
         vec4 n = normalize(normal);
@@ -137,10 +201,12 @@ void main()
 
         color =  Kd * light_spectrum * lambert_diffuse_term
               + Ka * ambient_light_spectrum
-              + Ks * light_spectrum * phong_specular_term;
+              + Ks * light_spectrum * phong_specular_term
+              + Kd * ClusteredLighting(p, n);
     }
 
-    else if ( object_id == BOX) {
+#elif OBJECT_ID == BOX
+    {
 
       if (position_model.x == -1 || position_model.x == 1) {
         U = (position_model.y + 1)/2;
@@ -157,18 +223,19 @@ void main()
         V = (position_model.x + 1)/2;
       }
 
-      vec3 Kd = texture(TextureImage6, vec2(U,V)).rgb;
+      vec3 Kd = texture(material_texture, vec3(U,V,material_layer)).rgb;
 
       // Equação de Iluminação
       vec4 tmp = vec4(0.0f, -1.0f, 0.0f, 0.0f);
       float lambert = max(0,dot(n,tmp));
 
-      color = Kd* (lambert + 0.5f);
+      color = Kd* (lambert + 0.5f + ClusteredLighting(p, n));
 
 
 
     }
-    else if ( object_id == CENTRAL_SPHERE) {
+#elif OBJECT_ID == CENTRAL_SPHERE
+    {
 
       vec4 bbox_center = (bbox_min + bbox_max) / 2.0;
 
@@ -179,31 +246,17 @@ void main()
       U = (theta+M_PI)/(2*M_PI);
       V = (phi+M_PI_2)/(M_PI);
 
-      float range = 0.01f;
-
-      float a = U;
-      float b = V;
+      U *= uv_scale.x;
+      V *= uv_scale.y;
 
-      while (a>range)
-        a -= range;
-      a /= range;
-
-
-      while (b>range)
-        b-=range;
-      b=b/range;
-
-      U=a;
-      V=b;
-
-      Kd2 = texture(TextureImage4, vec2(U,V)).rgb;
+      Kd2 = texture(material_texture, vec3(U,V,material_layer)).rgb;
 
       // Equação de Iluminação
       float lambert = max(0,dot(n,l));
 
-      color = Kd2* (lambert + 0.2);
+      color = Kd2* (lambert + 0.2 + ClusteredLighting(p, n));
     }
-    else if ( object_id == BUNNY )
+#elif OBJECT_ID == BUNNY
     {
         // PREENCHA AQUI
         // Propriedades espectrais do coelho
@@ -213,7 +266,7 @@ void main()
         q = 32.0;
     }
 
-    else if ( object_id == ESTACA )
+#elif OBJECT_ID == ESTACA
     {
         // PREENCHA AQUI
         // Propriedades espectrais do coelho
@@ -223,35 +276,21 @@ void main()
         q = 2.0;
     }
 
-    else if ( object_id == BORDER )
+#elif OBJECT_ID == BORDER
     {
 
-      float range = 0.035f;
-
-      float a = texcoords.x;
-      float b = texcoords.y;
-
-      while (a>range)
-        a -= range;
-      a /= range;
-
-
-      while (b>range)
-        b-=range;
-      b=b/range;
+      U = texcoords.x * uv_scale.x;
+      V = texcoords.y * uv_scale.y;
 
-      U=a;
-      V=b;
-
-      Kd1 = texture(TextureImage3, vec2(U,V)).rgb;
+      Kd1 = texture(material_texture, vec3(U,V,material_layer)).rgb;
 
       // Equação de Iluminação
       float lambert = max(0,dot(n,l));
 
-      color = Kd1* (lambert + 1);
+      color = Kd1* (lambert + 1 + ClusteredLighting(p, n));
     }
 
-    else if ( object_id == PLANE )
+#elif OBJECT_ID == PLANE
     {
         // PREENCHA AQUI
         // Propriedades espectrais do plano
@@ -261,33 +300,19 @@ void main()
         // q = 20.0;
 
         // Coordenadas de textura do plano,i
-        // obtidas do arquivo OBJ.
-        float range = 0.025f;
-
-        float a = texcoords.x;
-        float b = texcoords.y;
-
-        while (a>range)
-          a -= range;
-        a /= range;
-
+        // obtidas do arquivo OBJ, repetidas uv_scale vezes.
+        U = texcoords.x * uv_scale.x;
+        V = texcoords.y * uv_scale.y;
 
-        while (b>range)
-          b-=range;
-        b=b/range;
-
-        U=a;
-        V=b;
-
-        vec3 Kd0 = texture(TextureImage0, vec2(U,V)).rgb;
+        vec3 Kd0 = texture(material_texture, vec3(U,V,material_layer)).rgb;
 
         // Equação de Iluminação
         float lambert = max(0,dot(n,l));
 
-        color = Kd0 * (lambert + 0.01);
+        color = Kd0 * (lambert + 0.01 + ClusteredLighting(p, n));
     }
 
-    else if ( object_id == MARIO)
+#elif OBJECT_ID == MARIO
     {
       // Kd = vec3(0.08, 0.4, 0.8);
       // Ks = vec3(0.8, 0.8, 0.8);
@@ -298,15 +323,16 @@ void main()
 
       U = texcoords.x;
       V = texcoords.y;
-      vec3 Kd0 = texture(TextureImage1, vec2(U,V)).rgb;
+      vec3 Kd0 = texture(material_texture, vec3(U,V,material_layer)).rgb;
 
       // Equação de Iluminação
       float lambert = max(0,dot(n,l_mario));
 
-      color = Kd0 * (lambert + 0.01);
+      color = Kd0 * (lambert + 0.01 + ClusteredLighting(p, n));
 
     }
-    else if ( object_id == REGULAR_COW) {
+#elif OBJECT_ID == REGULAR_COW
+    {
 
       vec4 bbox_center = (bbox_min + bbox_max) / 2.0;
 
@@ -317,30 +343,26 @@ void main()
       U = (theta+M_PI)/(2*M_PI);
       V = (phi+M_PI_2)/(M_PI);
 
-      vec3 Kd = texture(TextureImage5, vec2(U,V)).rgb;
+      vec3 Kd = texture(material_texture, vec3(U,V,material_layer)).rgb;
 
       // Equação de Iluminação
       float lambert = max(0,dot(n,l));
 
-      color = Kd* (lambert + 0.2);
+      color = Kd* (lambert + 0.2 + ClusteredLighting(p, n));
 
 
     }
-    else // Objeto desconhecido = preto
+#else // Objeto desconhecido = preto
     {
         Kd = vec3(0.0,0.0,0.0);
         Ks = vec3(0.0,0.0,0.0);
         Ka = vec3(0.0,0.0,0.0);
         q = 1.0;
     }
+#endif
     // Termo difuso utilizando a lei dos cossenos de Lambert
-    if ( object_id != PLANE
-      && object_id != MARIO
-      && object_id != BORDER
-      && object_id != CENTRAL_SPHERE
-      && object_id != REGULAR_COW
-      && object_id != BOX
-      && object_id != GOLDEN_COW) {
+#if OBJECT_ID != PLANE && OBJECT_ID != MARIO && OBJECT_ID != BORDER && OBJECT_ID != CENTRAL_SPHERE && OBJECT_ID != REGULAR_COW && OBJECT_ID != BOX && OBJECT_ID != GOLDEN_COW
+      {
       float lambert_diffuse_term = max(0.0, dot(n,l)); // PREENCHA AQUI o termo difuso de Lambert
 
       // Termo especular utilizando o modelo de iluminação de Phong
@@ -358,7 +380,13 @@ void main()
       color =  Kd * light_spectrum * lambert_diffuse_term
             + Ka * ambient_light_spectrum
             + Ks * light_spectrum * phong_specular_term;
+
+      // O céu (SPHERE) não é iluminado pelas fontes de luz pontuais
+#if OBJECT_ID != SPHERE
+      color += Kd * ClusteredLighting(p, n);
+#endif
       }
+#endif
 
 
       // Cor final com correção gamma, considerando monitor sRGB.
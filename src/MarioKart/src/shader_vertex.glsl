@@ -1,15 +1,39 @@
 #version 330 core
 
 // Atributos de vrtice recebidos como entrada ("in") pelo Vertex Shader.
-// Veja a funo BuildTrianglesAndAddToVirtualScene() em "main.cpp".
-layout (location = 0) in vec4 model_coefficients;
-layout (location = 1) in vec4 normal_coefficients;
+// Veja a estrutura SceneVertex e a funo UploadVirtualSceneToGpu() em
+// "main.cpp": a normal  lida de inteiros de 10 bits e as coordenadas de
+// textura de half floats, ambos convertidos para float pela GPU.
+layout (location = 0) in vec3 position_coefficients;
+layout (location = 1) in vec3 normal_coefficients;
 layout (location = 2) in vec2 texture_coefficients;
 
-// Matrizes computadas no cdigo C++ e enviadas para a GPU
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Matriz "model" de cada instncia (ocupa as locations 3, 4, 5 e 6), usada
+// quando o objeto  desenhado com glDrawElementsInstanced(). Veja a funo
+// DrawVirtualObjectInstanced() em "main.cpp".
+layout (location = 3) in mat4 instance_model;
+
+// Parmetros computados no cdigo C++ e enviados para a GPU atravs de
+// uniform blocks. Veja as estruturas FrameUniforms e DrawUniforms e a funo
+// SubmitDrawCommands() em "main.cpp". Estas declaraes devem ser idnticas
+// s de "shader_fragment.glsl".
+layout (std140) uniform FrameUniforms
+{
+    mat4 view;
+    mat4 projection;
+    vec4 camera_position;
+    vec4 light_direction;
+    vec4 cluster_params;
+};
+
+layout (std140) uniform DrawUniforms
+{
+    mat4 model;
+    mat4 normal_matrix; // inverse(transpose(model)), computada na CPU
+    vec4 bbox_min;
+    vec4 bbox_max;
+    int  instanced;     // Se a matriz de modelagem vem do atributo por instncia
+};
 
 // Atributos de vrtice que sero gerados como sada ("out") pelo Vertex Shader.
 // ** Estes sero interpolados pelo rasterizador! ** gerando, assim, valores
@@ -22,6 +46,27 @@ out vec2 texcoords;
 
 void main()
 {
+    // Posio do vrtice em coordenadas homogneas (w = 1 para pontos)
+    vec4 model_coefficients = vec4(position_coefficients, 1.0);
+
+    // Matrizes de modelagem e das normais efetivamente utilizadas por este
+    // vrtice. As instncias devem ser transformaes de similaridade
+    // (rotao, translao e escala uniforme): para estas a matriz das normais
+    //  a prpria parte 3x3 de "instance_model", a menos de uma escala que 
+    // removida pela normalizao no Fragment Shader.
+    mat4 M;
+    mat3 N;
+    if ( instanced != 0 )
+    {
+        M = instance_model;
+        N = mat3(instance_model);
+    }
+    else
+    {
+        M = model;
+        N = mat3(normal_matrix);
+    }
+
     // A varivel gl_Position define a posio final de cada vrtice
     // OBRIGATORIAMENTE em "normalized device coordinates" (NDC), onde cada
     // coeficiente est entre -1 e 1.  (Veja slides 135 e 141 do documento
@@ -34,7 +79,7 @@ void main()
     // de vdeo (GPU) far a diviso por W. Veja slide 178 do documento
     // "Aula_09_Projecoes.pdf").
     //
-    gl_Position = projection * view * model * model_coefficients;
+    gl_Position = projection * view * M * model_coefficients;
 
     // Como as variveis acima  (tipo vec4) so vetores com 4 coeficientes,
     // tambm  possvel acessar e modificar cada coeficiente de maneira
@@ -48,15 +93,14 @@ void main()
     //
 
     // Posio do vrtice atual no sistema de coordenadas global (World).
-    position_world = model * model_coefficients;
+    position_world = M * model_coefficients;
 
     // Posio do vrtice atual no sistema de coordenadas local do modelo.
     position_model = model_coefficients;
 
     // Normal do vrtice atual no sistema de coordenadas global (World).
     // Veja slide 94 do documento "Aula_07_Transformacoes_Geometricas_3D.pdf".
-    normal = inverse(transpose(model)) * normal_coefficients;
-    normal.w = 0.0;
+    normal = vec4(N * normal_coefficients, 0.0);
 
     // Coordenadas de textura obtidas do arquivo OBJ (se existirem!)
     texcoords = texture_coefficients;
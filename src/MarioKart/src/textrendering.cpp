@@ -1,6 +1,7 @@
 // Based on http://hamelot.io/visualization/opengl-text-without-any-external-libraries/
 //   and on https://github.com/rougier/freetype-gl
 #include <string>
+#include <vector>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -11,7 +12,7 @@
 #include "utils.h"
 #include "dejavufont.h"
 
-GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id); // Função definida em main.cpp
+GLuint CreateGpuProgramFromSource(const std::string& vertex_source, const std::string& fragment_source, const char* vertex_name, const char* fragment_name); // Função definida em main.cpp
 
 const GLchar* const textvertexshader_source = ""
 "#version 330\n"
@@ -35,58 +36,44 @@ const GLchar* const textfragmentshader_source = ""
 "}\n"
 "\0";
 
-void TextRendering_LoadShader(const GLchar* const shader_string, GLuint shader_id)
-{
-    // Define o código do shader, contido na string "shader_string"
-    glShaderSource(shader_id, 1, &shader_string, NULL);
-
-    // Compila o código do shader (em tempo de execução)
-    glCompileShader(shader_id);
-
-    // Verificamos se ocorreu algum erro ou "warning" durante a compilação
-    GLint compiled_ok;
-    glGetShaderiv(shader_id, GL_COMPILE_STATUS, &compiled_ok);
-
-    GLint log_length = 0;
-    glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &log_length);
-
-    // Alocamos memória para guardar o log de compilação.
-    // A chamada "new" em C++ é equivalente ao "malloc()" do C.
-    GLchar* log = new GLchar[log_length];
-    glGetShaderInfoLog(shader_id, log_length, &log_length, log);
-
-    // Imprime no terminal qualquer erro ou "warning" de compilação
-    if ( log_length != 0 )
-    {
-        std::string  output;
-
-        if ( !compiled_ok )
-        {
-            output += "ERROR: OpenGL compilation failed.\n";
-            output += "== Start of compilation log\n";
-            output += log;
-            output += "== End of compilation log\n";
-        }
-        else
-        {
-            output += "ERROR: OpenGL compilation failed.\n";
-            output += "== Start of compilation log\n";
-            output += log;
-            output += "== End of compilation log\n";
-        }
-
-        fprintf(stderr, "%s", output.c_str());
-    }
-
-    // A chamada "delete" em C++ é equivalente ao "free()" do C
-    delete [] log;
-}
-
 GLuint textVAO;
 GLuint textVBO;
 GLuint textprogram_id;
 GLuint texttexture_id;
 
+// Tabela que mapeia cada caractere ASCII para o seu glifo na fonte, ou NULL
+// se a fonte não possui o caractere. Preenchida em TextRendering_Init().
+#define TEXT_GLYPH_TABLE_SIZE 128
+texture_glyph_t* textglyphs[TEXT_GLYPH_TABLE_SIZE];
+
+// Vértices {x,y,s,t} dos glifos impressos no quadro atual. As funções
+// TextRendering_PrintString() somente acumulam os glifos neste vetor, que é
+// copiado para a GPU e desenhado com uma única chamada em
+// TextRendering_Flush(), ao fim do quadro.
+struct TextVertex
+{
+    float x, y, s, t;
+};
+std::vector<TextVertex> textvertices;
+
+// Texto "retido": guarda os vértices de uma string já posicionada, que são
+// reaproveitados enquanto o texto, a posição, a escala e o tamanho da janela
+// não mudam. Veja TextRendering_CreateLayout() e TextRendering_PrintLayout().
+struct TextLayout
+{
+    std::string text;
+    float x, y, scale;
+    int window_width, window_height;
+    std::vector<TextVertex> vertices;
+};
+std::vector<TextLayout> textlayouts;
+
+// Tamanho da janela, consultado uma única vez por quadro (veja
+// TextRendering_GetWindowSize()). Zero indica que deve ser consultado
+// novamente.
+int textwindow_width = 0;
+int textwindow_height = 0;
+
 void TextRendering_Init()
 {
     GLuint sampler;
@@ -101,16 +88,8 @@ void TextRendering_Init()
     glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glCheckError();
 
-    GLuint textvertexshader_id = glCreateShader(GL_VERTEX_SHADER);
-    TextRendering_LoadShader(textvertexshader_source, textvertexshader_id);
-    glCheckError();
-
-    GLuint textfragmentshader_id = glCreateShader(GL_FRAGMENT_SHADER);
-    TextRendering_LoadShader(textfragmentshader_source, textfragmentshader_id);
-    glCheckError();
-
-    textprogram_id = CreateGpuProgram(textvertexshader_id, textfragmentshader_id);
-    glLinkProgram(textprogram_id);
+    // O programa é compilado somente se não está no cache de programas
+    textprogram_id = CreateGpuProgramFromSource(textvertexshader_source, textfragmentshader_source, "textvertexshader", "textfragmentshader");
     glCheckError();
 
     GLuint texttex_uniform;
@@ -127,7 +106,7 @@ void TextRendering_Init()
     glBindVertexArray(textVAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-    glBufferData(GL_ARRAY_BUFFER, 24 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, 0, NULL, GL_STREAM_DRAW);
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
     glEnableVertexAttribArray(0);
     glCheckError();
@@ -140,30 +119,41 @@ void TextRendering_Init()
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
     glCheckError();
+
+    for (size_t i = 0; i < TEXT_GLYPH_TABLE_SIZE; ++i)
+        textglyphs[i] = NULL;
+    for (size_t j = 0; j < dejavufont.glyphs_count; ++j)
+    {
+        uint32_t codepoint = dejavufont.glyphs[j].codepoint;
+        if (codepoint < TEXT_GLYPH_TABLE_SIZE && textglyphs[codepoint] == NULL)
+            textglyphs[codepoint] = &dejavufont.glyphs[j];
+    }
 }
 
 float textscale = 3.5f;
 
-void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float x, float y, float scale = 1.0f)
+void TextRendering_GetWindowSize(GLFWwindow* window, int* width, int* height)
+{
+    if ( textwindow_width == 0 || textwindow_height == 0 )
+        glfwGetWindowSize(window, &textwindow_width, &textwindow_height);
+
+    *width = textwindow_width;
+    *height = textwindow_height;
+}
+
+// Gera os vértices dos glifos de "str", posicionada em (x,y), e os adiciona
+// ao final de "vertices".
+void TextRendering_LayoutString(int width, int height, const std::string &str, float x, float y, float scale, std::vector<TextVertex>& vertices)
 {
     scale *= textscale;
-    int width, height;
-    glfwGetWindowSize(window, &width, &height);
     float sx = scale / width;
     float sy = scale / height;
 
     for (size_t i = 0; i < str.size(); i++)
     {
         // Find the glyph for the character we are looking for
-        texture_glyph_t *glyph = 0;
-        for (size_t j = 0; j < dejavufont.glyphs_count; ++j)
-        {
-            if (dejavufont.glyphs[j].codepoint == (uint32_t)str[i])
-            {
-                glyph = &dejavufont.glyphs[j];
-                break;
-            }
-        }
+        unsigned char c = (unsigned char)str[i];
+        texture_glyph_t *glyph = (c < TEXT_GLYPH_TABLE_SIZE) ? textglyphs[c] : NULL;
         if (!glyph) {
             continue;
         }
@@ -178,7 +168,7 @@ void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float
         float s1 = glyph->s1 - 0.5f/dejavufont.tex_width;
         float t1 = glyph->t1 - 0.5f/dejavufont.tex_height;
 
-        struct {float x, y, s, t;} data[6] = {
+        TextVertex data[6] = {
             { x0, y0, s0, t0 },
             { x0, y1, s0, t1 },
             { x1, y1, s1, t1 },
@@ -186,42 +176,103 @@ void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float
             { x1, y1, s1, t1 },
             { x1, y0, s1, t0 }
         };
+        vertices.insert(vertices.end(), data, data + 6);
 
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        x += (glyph->advance_x * sx);
+    }
+}
 
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDepthFunc(GL_ALWAYS);
-        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, 24 * sizeof(float), data);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float x, float y, float scale = 1.0f)
+{
+    int width, height;
+    TextRendering_GetWindowSize(window, &width, &height);
+    TextRendering_LayoutString(width, height, str, x, y, scale, textvertices);
+}
 
-        glUseProgram(textprogram_id);
-        glBindVertexArray(textVAO);
+// Cria um texto retido, inicialmente vazio, e retorna o seu identificador
+int TextRendering_CreateLayout()
+{
+    textlayouts.push_back(TextLayout());
+    textlayouts.back().x = textlayouts.back().y = textlayouts.back().scale = 0.0f;
+    textlayouts.back().window_width = textlayouts.back().window_height = 0;
+    return (int)textlayouts.size() - 1;
+}
 
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+// Equivalente a TextRendering_PrintString(), mas os glifos somente são
+// posicionados novamente quando o texto, a posição, a escala ou o tamanho da
+// janela mudam desde a última chamada com o mesmo "layout". Caso contrário,
+// os vértices guardados são simplesmente copiados para o quadro atual.
+void TextRendering_PrintLayout(GLFWwindow* window, int layout, const char* str, float x, float y, float scale = 1.0f)
+{
+    int width, height;
+    TextRendering_GetWindowSize(window, &width, &height);
 
-        glBindVertexArray(0);
-        glUseProgram(0);
-        glDepthFunc(GL_LESS);
+    TextLayout& l = textlayouts[layout];
+    if ( l.window_width != width || l.window_height != height
+      || l.x != x || l.y != y || l.scale != scale || l.text != str )
+    {
+        l.text = str;
+        l.x = x;
+        l.y = y;
+        l.scale = scale;
+        l.window_width = width;
+        l.window_height = height;
+        l.vertices.clear();
+        TextRendering_LayoutString(width, height, l.text, x, y, scale, l.vertices);
+    }
 
-        glDisable(GL_BLEND);
+    textvertices.insert(textvertices.end(), l.vertices.begin(), l.vertices.end());
+}
 
-        x += (glyph->advance_x * sx);
-    }
+// Desenha todos os glifos acumulados desde a última chamada com uma única
+// chamada glDrawArrays(). Deve ser chamada uma vez por quadro, antes de
+// glfwSwapBuffers(), depois de toda a cena 3D.
+void TextRendering_Flush()
+{
+    // O tamanho da janela será consultado novamente no próximo quadro
+    textwindow_width = 0;
+    textwindow_height = 0;
+
+    if ( textvertices.empty() )
+        return;
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glDepthFunc(GL_ALWAYS);
+
+    // Um novo armazenamento é alocado a cada quadro ("orphaning"), para que
+    // a CPU não precise esperar a GPU terminar de ler o quadro anterior.
+    glBindBuffer(GL_ARRAY_BUFFER, textVBO);
+    glBufferData(GL_ARRAY_BUFFER, textvertices.size() * sizeof(TextVertex), &textvertices[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glUseProgram(textprogram_id);
+    glBindVertexArray(textVAO);
+
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)textvertices.size());
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glDepthFunc(GL_LESS);
+
+    glDisable(GL_BLEND);
+
+    textvertices.clear();
 }
 
 float TextRendering_LineHeight(GLFWwindow* window)
 {
     int width, height;
-    glfwGetWindowSize(window, &width, &height);
+    TextRendering_GetWindowSize(window, &width, &height);
     return dejavufont.height / height * textscale;
 }
 
 float TextRendering_CharWidth(GLFWwindow* window)
 {
     int width, height;
-    glfwGetWindowSize(window, &width, &height);
+    TextRendering_GetWindowSize(window, &width, &height);
     return dejavufont.glyphs[32].advance_x / width * textscale;
 }
 
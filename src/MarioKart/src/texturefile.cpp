@@ -0,0 +1,98 @@
+// Leitura e escrita de texturas pré-processadas. Veja "texturefile.h".
+#include <cstdio>
+#include <cstring>
+
+#include "texturefile.h"
+
+std::string TextureFile_CookedFilename(const char* image_filename)
+{
+    return std::string(image_filename) + ".tex";
+}
+
+bool TextureFile_Write(const char* filename, unsigned int format, const std::vector<ImageLevel>& levels, const std::vector< std::vector<unsigned char> >& level_data)
+{
+    TextureFileHeader header;
+    header.magic      = TEXTURE_FILE_MAGIC;
+    header.version    = TEXTURE_FILE_VERSION;
+    header.format     = format;
+    header.width      = levels[0].width;
+    header.height     = levels[0].height;
+    header.num_levels = levels.size();
+
+    std::vector<TextureFileLevel> table(levels.size());
+    size_t offset = sizeof(TextureFileHeader) + levels.size() * sizeof(TextureFileLevel);
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        table[i].width  = levels[i].width;
+        table[i].height = levels[i].height;
+        table[i].offset = offset;
+        table[i].size   = level_data[i].size();
+
+        // Os dados de cada nível começam em uma posição múltipla de 4 bytes
+        offset += (level_data[i].size() + 3) & ~(size_t)3;
+    }
+
+    FILE* file = fopen(filename, "wb");
+    if ( file == NULL )
+        return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+           && fwrite(table.data(), sizeof(TextureFileLevel), table.size(), file) == table.size();
+
+    for (size_t i = 0; ok && i < levels.size(); ++i)
+    {
+        static const unsigned char padding[3] = { 0, 0, 0 };
+        size_t padding_size = ((level_data[i].size() + 3) & ~(size_t)3) - level_data[i].size();
+
+        ok = fwrite(level_data[i].data(), 1, level_data[i].size(), file) == level_data[i].size()
+          && fwrite(padding, 1, padding_size, file) == padding_size;
+    }
+
+    if ( fclose(file) != 0 )
+        ok = false;
+
+    return ok;
+}
+
+bool TextureFile_Open(const char* filename, const char* source_filename, TextureFile& file)
+{
+    memset(&file, 0, sizeof(file));
+
+    if ( !MappedFile_Open(filename, source_filename, file.mapping) )
+        return false;
+
+    file.data   = (const unsigned char*)file.mapping.data;
+    file.header = (const TextureFileHeader*)file.data;
+
+    if ( file.mapping.size < sizeof(TextureFileHeader) || file.header->magic != TEXTURE_FILE_MAGIC || file.header->version != TEXTURE_FILE_VERSION )
+    {
+        TextureFile_Close(file);
+        return false;
+    }
+
+    size_t levels_end = sizeof(TextureFileHeader) + (size_t)file.header->num_levels * sizeof(TextureFileLevel);
+    if ( file.header->num_levels == 0 || levels_end > file.mapping.size )
+    {
+        TextureFile_Close(file);
+        return false;
+    }
+
+    file.levels = (const TextureFileLevel*)(file.data + sizeof(TextureFileHeader));
+
+    for (unsigned int i = 0; i < file.header->num_levels; ++i)
+    {
+        if ( file.levels[i].offset < levels_end || (size_t)file.levels[i].offset + file.levels[i].size > file.mapping.size )
+        {
+            TextureFile_Close(file);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void TextureFile_Close(TextureFile& file)
+{
+    MappedFile_Close(file.mapping);
+    memset(&file, 0, sizeof(file));
+}
@@ -0,0 +1,289 @@
+// Pré-processamento de imagens de textura. Veja "textureprocessing.h".
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "textureprocessing.h"
+
+// Conversões entre a codificação sRGB (8 bits) e intensidades lineares em [0,1]
+static float SrgbToLinear(unsigned char value)
+{
+    float c = value / 255.0f;
+    return (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static unsigned char LinearToSrgb(float value)
+{
+    float c = (value <= 0.0031308f) ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+    return (unsigned char)std::min(std::max(c * 255.0f + 0.5f, 0.0f), 255.0f);
+}
+
+void TextureProcessing_BuildMipChain(const unsigned char* pixels, int width, int height, std::vector<ImageLevel>& levels)
+{
+    float srgb_to_linear[256];
+    for (int i = 0; i < 256; ++i)
+        srgb_to_linear[i] = SrgbToLinear(i);
+
+    levels.clear();
+    levels.push_back(ImageLevel());
+    levels[0].width  = width;
+    levels[0].height = height;
+    levels[0].pixels.assign(pixels, pixels + 3*width*height);
+
+    while ( levels.back().width > 1 || levels.back().height > 1 )
+    {
+        const ImageLevel& src = levels.back();
+
+        ImageLevel dst;
+        dst.width  = std::max(1, src.width / 2);
+        dst.height = std::max(1, src.height / 2);
+        dst.pixels.resize(3*dst.width*dst.height);
+
+        for (int y = 0; y < dst.height; ++y)
+        {
+            int y0 = std::min(2*y,     src.height - 1);
+            int y1 = std::min(2*y + 1, src.height - 1);
+
+            for (int x = 0; x < dst.width; ++x)
+            {
+                int x0 = std::min(2*x,     src.width - 1);
+                int x1 = std::min(2*x + 1, src.width - 1);
+
+                for (int c = 0; c < 3; ++c)
+                {
+                    float sum = srgb_to_linear[src.pixels[3*(y0*src.width + x0) + c]]
+                              + srgb_to_linear[src.pixels[3*(y0*src.width + x1) + c]]
+                              + srgb_to_linear[src.pixels[3*(y1*src.width + x0) + c]]
+                              + srgb_to_linear[src.pixels[3*(y1*src.width + x1) + c]];
+
+                    dst.pixels[3*(y*dst.width + x) + c] = LinearToSrgb(sum / 4.0f);
+                }
+            }
+        }
+
+        levels.push_back(dst);
+    }
+}
+
+// Cores RGB 5:6:5 dos extremos de um bloco BC1
+static unsigned short PackRGB565(const float color[3])
+{
+    int r = (int)(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    int g = (int)(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+    int b = (int)(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static void UnpackRGB565(unsigned short packed, float color[3])
+{
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    color[0] = (float)((r << 3) | (r >> 2));
+    color[1] = (float)((g << 2) | (g >> 4));
+    color[2] = (float)((b << 3) | (b >> 2));
+}
+
+static float DistanceSquared(const float a[3], const float b[3])
+{
+    float dr = a[0] - b[0];
+    float dg = a[1] - b[1];
+    float db = a[2] - b[2];
+    return dr*dr + dg*dg + db*db;
+}
+
+// Escolhe os índices dos pixels de um bloco para os extremos dados (modo de
+// quatro cores, c0 > c1) e retorna o erro quadrático total.
+static float EncodeBlockIndices(const float pixels[16][3], unsigned short c0, unsigned short c1, unsigned char indices[16])
+{
+    float palette[4][3];
+    UnpackRGB565(c0, palette[0]);
+    UnpackRGB565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c)
+    {
+        palette[2][c] = (2.0f*palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f*palette[1][c]) / 3.0f;
+    }
+
+    float error = 0.0f;
+    for (int i = 0; i < 16; ++i)
+    {
+        int best = 0;
+        float best_distance = DistanceSquared(pixels[i], palette[0]);
+        for (int p = 1; p < 4; ++p)
+        {
+            float distance = DistanceSquared(pixels[i], palette[p]);
+            if ( distance < best_distance )
+            {
+                best = p;
+                best_distance = distance;
+            }
+        }
+        indices[i] = best;
+        error += best_distance;
+    }
+
+    return error;
+}
+
+// Codifica um bloco com os extremos dados, retornando o erro quadrático total
+static float EncodeBlock(const float pixels[16][3], const float e0[3], const float e1[3], unsigned char* block)
+{
+    unsigned short c0 = PackRGB565(e0);
+    unsigned short c1 = PackRGB565(e1);
+
+    // O modo de quatro cores exige c0 > c1; extremos iguais usam só o índice 0
+    unsigned char indices[16];
+    float error;
+    if ( c0 == c1 )
+    {
+        float color[3];
+        UnpackRGB565(c0, color);
+        memset(indices, 0, sizeof(indices));
+        error = 0.0f;
+        for (int i = 0; i < 16; ++i)
+            error += DistanceSquared(pixels[i], color);
+    }
+    else
+    {
+        if ( c0 < c1 )
+            std::swap(c0, c1);
+        error = EncodeBlockIndices(pixels, c0, c1, indices);
+    }
+
+    block[0] = c0 & 0xFF;
+    block[1] = c0 >> 8;
+    block[2] = c1 & 0xFF;
+    block[3] = c1 >> 8;
+    for (int y = 0; y < 4; ++y)
+        block[4 + y] = indices[4*y + 0] | (indices[4*y + 1] << 2) | (indices[4*y + 2] << 4) | (indices[4*y + 3] << 6);
+
+    return error;
+}
+
+// Comprime um bloco de 4x4 pixels. Os extremos iniciais são obtidos pela
+// projeção dos pixels no eixo principal das suas cores e depois refinados por
+// mínimos quadrados a partir dos índices escolhidos.
+static void CompressBlock(const float pixels[16][3], unsigned char* block)
+{
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; ++i)
+        for (int c = 0; c < 3; ++c)
+            mean[c] += pixels[i][c] / 16.0f;
+
+    float covariance[3][3] = { { 0.0f } };
+    for (int i = 0; i < 16; ++i)
+    {
+        float d[3] = { pixels[i][0] - mean[0], pixels[i][1] - mean[1], pixels[i][2] - mean[2] };
+        for (int a = 0; a < 3; ++a)
+            for (int b = 0; b < 3; ++b)
+                covariance[a][b] += d[a]*d[b];
+    }
+
+    // Eixo principal por iterações de potência
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; ++iteration)
+    {
+        float next[3];
+        for (int a = 0; a < 3; ++a)
+            next[a] = covariance[a][0]*axis[0] + covariance[a][1]*axis[1] + covariance[a][2]*axis[2];
+
+        float length = sqrtf(next[0]*next[0] + next[1]*next[1] + next[2]*next[2]);
+        if ( length < 1e-6f )
+            break;
+
+        for (int a = 0; a < 3; ++a)
+            axis[a] = next[a] / length;
+    }
+
+    float tmin =  1e30f;
+    float tmax = -1e30f;
+    for (int i = 0; i < 16; ++i)
+    {
+        float t = (pixels[i][0] - mean[0])*axis[0] + (pixels[i][1] - mean[1])*axis[1] + (pixels[i][2] - mean[2])*axis[2];
+        tmin = std::min(tmin, t);
+        tmax = std::max(tmax, t);
+    }
+
+    // Os extremos são aproximados levemente do centro, reduzindo o erro médio
+    float inset = (tmax - tmin) / 16.0f;
+    float e0[3];
+    float e1[3];
+    for (int c = 0; c < 3; ++c)
+    {
+        e0[c] = mean[c] + axis[c]*(tmax - inset);
+        e1[c] = mean[c] + axis[c]*(tmin + inset);
+    }
+
+    float error = EncodeBlock(pixels, e0, e1, block);
+    if ( error == 0.0f )
+        return;
+
+    // Refinamento: com os índices fixos, cada pixel é aproximado por
+    // w*c0 + (1-w)*c1; resolvemos os extremos por mínimos quadrados.
+    static const float weights[4] = { 1.0f, 0.0f, 2.0f/3.0f, 1.0f/3.0f };
+
+    unsigned short c0 = block[0] | (block[1] << 8);
+    unsigned short c1 = block[2] | (block[3] << 8);
+    if ( c0 == c1 )
+        return;
+
+    float alpha2 = 0.0f, beta2 = 0.0f, alphabeta = 0.0f;
+    float alphax[3] = { 0.0f, 0.0f, 0.0f };
+    float betax[3]  = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; ++i)
+    {
+        int index = (block[4 + i/4] >> (2*(i%4))) & 3;
+        float w = weights[index];
+        alpha2    += w*w;
+        beta2     += (1.0f - w)*(1.0f - w);
+        alphabeta += w*(1.0f - w);
+        for (int c = 0; c < 3; ++c)
+        {
+            alphax[c] += w*pixels[i][c];
+            betax[c]  += (1.0f - w)*pixels[i][c];
+        }
+    }
+
+    float determinant = alpha2*beta2 - alphabeta*alphabeta;
+    if ( fabsf(determinant) < 1e-6f )
+        return;
+
+    float r0[3];
+    float r1[3];
+    for (int c = 0; c < 3; ++c)
+    {
+        r0[c] = (alphax[c]*beta2 - betax[c]*alphabeta) / determinant;
+        r1[c] = (betax[c]*alpha2 - alphax[c]*alphabeta) / determinant;
+    }
+
+    unsigned char refined[8];
+    if ( EncodeBlock(pixels, r0, r1, refined) < error )
+        memcpy(block, refined, sizeof(refined));
+}
+
+void TextureProcessing_CompressBC1(const ImageLevel& level, std::vector<unsigned char>& blocks)
+{
+    int blocks_x = (level.width + 3) / 4;
+    int blocks_y = (level.height + 3) / 4;
+
+    blocks.resize(8*blocks_x*blocks_y);
+
+    for (int by = 0; by < blocks_y; ++by)
+    {
+        for (int bx = 0; bx < blocks_x; ++bx)
+        {
+            float pixels[16][3];
+            for (int i = 0; i < 16; ++i)
+            {
+                int x = std::min(4*bx + i%4, level.width - 1);
+                int y = std::min(4*by + i/4, level.height - 1);
+                for (int c = 0; c < 3; ++c)
+                    pixels[i][c] = level.pixels[3*(y*level.width + x) + c];
+            }
+
+            CompressBlock(pixels, &blocks[8*(by*blocks_x + bx)]);
+        }
+    }
+}